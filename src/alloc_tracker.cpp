@@ -0,0 +1,137 @@
+#include "alloc_tracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Atomic, as threads working for this one count into it too.
+struct alloc_account {
+    std::atomic<size_t> count{};
+    std::atomic<size_t> bytes{};
+    std::atomic<bool>   forbidden{false};
+    std::atomic<size_t> scope_violations{};
+};
+
+namespace {
+
+thread_local alloc_stats    t_own{};
+thread_local alloc_account  t_account{};
+thread_local alloc_account *t_working_for{};
+thread_local size_t         t_violations{};
+
+auto current_account() -> alloc_account & {
+    return t_working_for != nullptr ? *t_working_for : t_account;
+}
+
+#ifdef FLOX_TRACK_ALLOCATIONS
+void record(size_t size) {
+    ++t_own.count;
+    t_own.bytes += size;
+    auto &a = current_account();
+    a.count.fetch_add(1, std::memory_order_relaxed);
+    a.bytes.fetch_add(size, std::memory_order_relaxed);
+    if(a.forbidden.load(std::memory_order_relaxed)) {
+        a.scope_violations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+auto allocate(size_t size, size_t alignment) -> void * {
+    record(size);
+    size          = size == 0 ? 1 : size;
+    void *pointer = nullptr;
+    if(alignment <= alignof(std::max_align_t)) {
+        pointer = std::malloc(size); // NOLINT
+    } else {
+        size    = (size + alignment - 1) / alignment * alignment;
+        pointer = std::aligned_alloc(alignment, size);
+    }
+    if(pointer == nullptr) {
+        throw std::bad_alloc{};
+    }
+    return pointer;
+}
+#endif
+
+} // namespace
+
+#ifdef FLOX_TRACK_ALLOCATIONS
+// NOLINTBEGIN(cppcoreguidelines-no-malloc)
+auto operator new(size_t size) -> void * {
+    return allocate(size, alignof(std::max_align_t));
+}
+auto operator new[](size_t size) -> void * {
+    return allocate(size, alignof(std::max_align_t));
+}
+auto operator new(size_t size, std::align_val_t al) -> void * {
+    return allocate(size, static_cast<size_t>(al));
+}
+auto operator new[](size_t size, std::align_val_t al) -> void * {
+    return allocate(size, static_cast<size_t>(al));
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t /*size*/) noexcept { std::free(p); }
+void operator delete[](void *p, size_t /*size*/) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t /*al*/) noexcept {
+    std::free(p);
+}
+void operator delete[](void *p, std::align_val_t /*al*/) noexcept {
+    std::free(p);
+}
+void operator delete(void *p, size_t /*size*/,
+                     std::align_val_t /*al*/) noexcept {
+    std::free(p);
+}
+void operator delete[](void *p, size_t /*size*/,
+                       std::align_val_t /*al*/) noexcept {
+    std::free(p);
+}
+// NOLINTEND(cppcoreguidelines-no-malloc)
+#endif
+
+auto allocations_tracked() -> bool {
+#ifdef FLOX_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+auto thread_allocations() -> alloc_stats {
+    return {t_account.count.load(std::memory_order_relaxed),
+            t_account.bytes.load(std::memory_order_relaxed)};
+}
+
+auto own_allocations() -> alloc_stats { return t_own; }
+
+auto thread_alloc_account() -> alloc_account & { return t_account; }
+
+alloc_proxy::alloc_proxy(alloc_account &account) : m_previous{t_working_for} {
+    t_working_for = &account;
+}
+
+alloc_proxy::~alloc_proxy() { t_working_for = m_previous; }
+
+no_alloc_scope::no_alloc_scope(char const *what)
+    : m_what{what}, m_outer{!t_account.forbidden} {
+    if(m_outer) {
+        t_account.scope_violations = 0;
+        t_account.forbidden        = true;
+    }
+}
+
+no_alloc_scope::~no_alloc_scope() {
+    if(!m_outer) {
+        return;
+    }
+    t_account.forbidden = false;
+    auto violations     = t_account.scope_violations.load();
+    if(violations > 0) {
+        t_violations += violations;
+        std::fprintf(stderr, "%zu allocations in steady state during %s\n",
+                     violations, m_what);
+    }
+}
+
+auto thread_alloc_violations() -> size_t { return t_violations; }
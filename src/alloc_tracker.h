@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+struct alloc_stats {
+    size_t count{};
+    size_t bytes{};
+
+    auto operator-(alloc_stats const &o) const -> alloc_stats {
+        return {count - o.count, bytes - o.bytes};
+    }
+};
+
+// True when built with FLOX_TRACK_ALLOCATIONS, which replaces the global
+// operator new/delete with counting versions.
+auto allocations_tracked() -> bool;
+
+// Allocations made by the calling thread so far, and by threads working for
+// it under an alloc_proxy.
+auto thread_allocations() -> alloc_stats;
+
+// Allocations made by the calling thread itself, whoever it works for.
+auto own_allocations() -> alloc_stats;
+
+// What a thread's allocations are counted against: its totals and whether
+// it is in a no_alloc_scope.
+struct alloc_account;
+
+auto thread_alloc_account() -> alloc_account &;
+
+// Lets a thread work for another. While alive, allocations on the calling
+// thread count towards the other's thread_allocations() and are violations
+// of its no_alloc_scope, if it has one.
+class alloc_proxy {
+    alloc_account *m_previous;
+
+  public:
+    explicit alloc_proxy(alloc_account &account);
+    alloc_proxy(alloc_proxy const &)                     = delete;
+    alloc_proxy(alloc_proxy &&)                          = delete;
+    auto operator=(alloc_proxy const &) -> alloc_proxy & = delete;
+    auto operator=(alloc_proxy &&) -> alloc_proxy      & = delete;
+    ~alloc_proxy();
+};
+
+// Steady state check. While a no_alloc_scope is alive, allocations on its
+// thread, or for it, are counted as violations and reported on stderr when
+// it ends.
+class no_alloc_scope {
+    char const *m_what;
+    bool        m_outer;
+
+  public:
+    explicit no_alloc_scope(char const *what);
+    no_alloc_scope(no_alloc_scope const &)                     = delete;
+    no_alloc_scope(no_alloc_scope &&)                          = delete;
+    auto operator=(no_alloc_scope const &) -> no_alloc_scope & = delete;
+    auto operator=(no_alloc_scope &&) -> no_alloc_scope      & = delete;
+    ~no_alloc_scope();
+};
+
+// Total steady state violations on the calling thread.
+auto thread_alloc_violations() -> size_t;
@@ -15,13 +15,29 @@ constexpr int      world_width  = 8 * window_width;
 constexpr int      world_height = 8 * window_height;
 rect<double> const world_rect{{0.0, 0.0}, {world_width, world_height}};
 
+constexpr uint64_t world_seed = 0xf10c5;
+
 constexpr size_t number_of_boids = 5000;
-constexpr size_t number_of_stars = 1000;
 
 constexpr double zoom_per_second = 1;
 
+// Zoomed out to this many world pixels a window pixel, boid sprites are a
+// few pixels across and a heatmap of heatmap_levels shades is drawn instead.
+constexpr double heatmap_zoom   = 4;
+constexpr size_t heatmap_levels = 8;
+
 constexpr size_t quad_tree_max_depth = 7;
 
+constexpr size_t steady_state_frames   = 120;
+constexpr size_t spatial_sort_interval = 600; // frames
+
+// Simulated frames a second at most, FLOX_MAX_FPS overrides it and 0 takes the
+// cap off. With no new frame to draw the render thread waits for input, for
+// frame_wait_ms or, while the simulation is idle, idle_wait_ms.
+constexpr unsigned max_frames_per_second = 120;
+constexpr int      frame_wait_ms         = 1;
+constexpr int      idle_wait_ms          = 100;
+
 constexpr double       ship_max_speed      = 1500.0;
 constexpr double       ship_max_accel      = 600.0;
 constexpr double       ship_max_yaw        = M_PI;
@@ -35,14 +51,37 @@ constexpr double       boid_cruise_speed       = 350.0;
 constexpr double       boid_max_accel          = 500.0;
 constexpr double       boid_average_separation = 55.0;
 constexpr double       boid_alignment_mult     = 2.75;
+constexpr double       boid_alignment_dist     = 250;
+constexpr double       boid_cohesion_dist      = 250;
 constexpr vec2d        boid_texture_center     = {20, 10};
 constexpr vec2d_t<int> boid_texture_size       = {40, 20};
 constexpr rect<double> boid_rect{tsize_to_rect(boid_texture_size)};
 
+// Approximate flocking takes a subtree whole once its size seen from the boid
+// is below this angle. Smaller is more accurate, 0 is exact.
+constexpr double flocking_theta = 0.5;
+
+// Topological flocking aligns with and keeps close to this many nearest
+// boids, however near or far they are.
+constexpr size_t flock_neighbours = 7;
+
+// Boids outside the view by more than lod_view_margin, farther than
+// lod_ship_distance from the ship and not in an explosion are simulated less
+// often when boid updates would take longer than boid_update_budget.
+constexpr double lod_view_margin    = 500;
+constexpr double lod_ship_distance  = 1000;
+constexpr size_t lod_max_interval   = 8;
+constexpr double boid_update_budget = 0.004; // seconds
+constexpr double lod_cost_smoothing = 0.1;
+
+// No more than this many of a frame's simulation tasks can run at once.
+constexpr size_t frame_task_threads = 4;
+
 constexpr double       shot_base_speed  = 2400;
 constexpr size_t       shot_cooldown_ms = 100;
 constexpr vec2d_t<int> shot_texture_size{10, 5};
 constexpr rect<double> shot_rect{tsize_to_rect(shot_texture_size)};
+constexpr size_t       max_shots = 64;
 
 constexpr double explosion_lethal_radius    = 60;
 constexpr double explosion_pressure_radius  = 300;
@@ -50,6 +89,7 @@ constexpr double explosion_visual_radius    = 150;
 constexpr size_t explosion_circle_segments  = 20;
 constexpr double explosion_pressure         = 8000;
 constexpr double explosion_pressure_per_sec = 60000;
+constexpr size_t max_explosions             = 64;
 
 constexpr vec2d  info_text_location{10, 10};
 constexpr size_t info_text_width =
@@ -68,4 +108,6 @@ constexpr char const *help_text =
     "P - TOGGLE PAUSE                 N - NEW BOID\n"
     "+ - ZOOM IN                      1 - ZOOM WINDOW\n"
     "- - ZOOM OUT                     0 - ZOOM WORLD\n"
-    "E - CENTER SHIP                  F - TOGGLE FPS\n";
+    "E - CENTER SHIP                  F - TOGGLE FPS\n"
+    "B - APPROXIMATE FLOCKING         L - TOGGLE LOD\n"
+    "T - TOPOLOGICAL FLOCKING\n";
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+
+#include "vec2d.h"
+
+// Polynomial atan2, max abs error below 2e-6 rad. Branch free so that loops
+// over it vectorize.
+constexpr auto fast_atan2(double y, double x) -> double {
+    constexpr double c1  = 0.99997726;
+    constexpr double c3  = -0.33262347;
+    constexpr double c5  = 0.19354346;
+    constexpr double c7  = -0.11643287;
+    constexpr double c9  = 0.05265332;
+    constexpr double c11 = -0.01172120;
+
+    double ax = x < 0 ? -x : x;
+    double ay = y < 0 ? -y : y;
+    double mx = ax < ay ? ay : ax;
+    double mn = ax < ay ? ax : ay;
+    double a  = mx > 0 ? mn / mx : 0.0;
+    double s  = a * a;
+    double r  = (((((c11 * s + c9) * s + c7) * s + c5) * s + c3) * s + c1) * a;
+    r = ay > ax ? M_PI / 2 - r : r;
+    r = x < 0 ? M_PI - r : r;
+    return y < 0 ? -r : r;
+}
+
+// Headings in degrees of a batch of direction vectors, for drawing.
+inline void fast_headings_deg(std::span<vec2d_t<double> const> dirs,
+                              std::span<double>                 out) {
+    constexpr double to_deg = 180.0 / M_PI;
+
+    size_t n = std::min(dirs.size(), out.size());
+    for(size_t i = 0; i < n; ++i) {
+        out[i] = fast_atan2(dirs[i].y, dirs[i].x) * to_deg;
+    }
+}
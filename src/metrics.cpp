@@ -0,0 +1,160 @@
+#include "metrics.h"
+
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+using sample_words = std::array<uint64_t, metrics_words>;
+
+constexpr int max_read_attempts = 100;
+
+auto map_segment(int fd, int protection) -> metrics_segment * {
+    void *p = mmap(nullptr, sizeof(metrics_segment), protection, MAP_SHARED,
+                   fd, 0);
+    return p == MAP_FAILED ? nullptr : static_cast<metrics_segment *>(p);
+}
+
+} // namespace
+
+auto index_sampler::sample(entity_tree const &tree)
+    -> quad_tree_stats const & {
+    tree.add_stats(m_partial, m_slice);
+    if(++m_slice == entity_tree::stats_slices) {
+        m_complete = m_partial;
+        m_partial  = {};
+        m_slice    = 0;
+    }
+    return m_complete;
+}
+
+auto metrics_of(state &st, index_sampler &index) -> metrics_sample {
+    metrics_sample s;
+    s.frame         = st.frame_count;
+    s.frame_time    = st.frame_time;
+    s.phase_seconds = st.phase_seconds;
+    for(size_t p = 0; p < phase_count; ++p) {
+        s.phase_allocations[p] = st.allocations[p].count;
+    }
+    s.alloc_violations = thread_alloc_violations();
+    s.boids            = st.boids.entities.size();
+    s.shots            = st.shots.entities.size();
+    s.explosions       = st.explosions.size();
+    s.lod_interval     = st.lod_simulation ? st.lod.interval : 1;
+
+    auto const &tree     = index.sample(st.boids.entities);
+    s.index_nodes        = tree.nodes;
+    s.index_depth        = tree.depth;
+    s.index_occupied     = tree.occupied;
+    s.index_max_contents = tree.max_contents;
+    return s;
+}
+
+metrics_writer::metrics_writer(char const *name) {
+    if(create(name) || errno != EEXIST) {
+        return;
+    }
+    // another flox is publishing there, or one that crashed left it behind
+    auto own = std::string{name} + "-" + std::to_string(getpid());
+    if(create(own)) {
+        std::fprintf(stderr, "%s is taken, metrics are published at %s\n",
+                     name, own.c_str());
+    }
+}
+
+// Only ever opens a segment it made itself, so no two writers share one.
+auto metrics_writer::create(std::string const &name) -> bool {
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644); // NOLINT
+    if(fd < 0) {
+        return false;
+    }
+    m_name = name;
+    if(ftruncate(fd, sizeof(metrics_segment)) == 0) {
+        m_segment = map_segment(fd, PROT_READ | PROT_WRITE);
+    }
+    close(fd);
+    if(m_segment == nullptr) {
+        shm_unlink(name.c_str());
+        errno = 0;
+        return false;
+    }
+    m_segment->version = metrics_version;
+    m_segment->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_ref{m_segment->magic}.store(metrics_magic,
+                                            std::memory_order_release);
+    return true;
+}
+
+metrics_writer::~metrics_writer() {
+    if(m_segment != nullptr) {
+        munmap(m_segment, sizeof(metrics_segment));
+        shm_unlink(m_name.c_str());
+    }
+}
+
+void metrics_writer::publish(metrics_sample const &s) {
+    if(m_segment == nullptr) {
+        return;
+    }
+    auto words = std::bit_cast<sample_words>(s);
+    auto seq   = m_segment->sequence.load(std::memory_order_relaxed);
+    m_segment->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for(size_t i = 0; i < metrics_words; ++i) {
+        std::atomic_ref{m_segment->words[i]}.store(words[i],
+                                                   std::memory_order_relaxed);
+    }
+    m_segment->sequence.store(seq + 2, std::memory_order_release);
+}
+
+metrics_reader::metrics_reader(char const *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) {
+        return;
+    }
+    struct stat st {};
+    if(fstat(fd, &st) == 0 &&
+       static_cast<size_t>(st.st_size) >= sizeof(metrics_segment)) {
+        m_segment = map_segment(fd, PROT_READ);
+    }
+    close(fd);
+    if(m_segment != nullptr &&
+       (std::atomic_ref{m_segment->magic}.load(std::memory_order_acquire) !=
+            metrics_magic ||
+        m_segment->version != metrics_version)) {
+        munmap(m_segment, sizeof(metrics_segment));
+        m_segment = nullptr;
+    }
+}
+
+metrics_reader::~metrics_reader() {
+    if(m_segment != nullptr) {
+        munmap(m_segment, sizeof(metrics_segment));
+    }
+}
+
+auto metrics_reader::read(metrics_sample &s) const -> bool {
+    sample_words words{};
+    for(int attempt = 0; attempt < max_read_attempts; ++attempt) {
+        auto before = m_segment->sequence.load(std::memory_order_acquire);
+        if((before & 1) != 0) {
+            continue;
+        }
+        for(size_t i = 0; i < metrics_words; ++i) {
+            words[i] = std::atomic_ref{m_segment->words[i]}.load(
+                std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(m_segment->sequence.load(std::memory_order_relaxed) == before) {
+            s = std::bit_cast<metrics_sample>(words);
+            return true;
+        }
+    }
+    return false;
+}
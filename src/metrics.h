@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+// Live metrics in a POSIX shared memory segment, written by the simulation
+// thread once a frame and read by flox_top. The segment layout is the
+// interface between the two, bump metrics_version when it changes.
+constexpr uint32_t    metrics_magic        = 0x584f4c46; // "FLOX"
+constexpr uint32_t    metrics_version      = 3;
+constexpr char const *metrics_default_name = "/flox-metrics";
+
+// Fixed size fields only, all of them 8 bytes.
+struct metrics_sample {
+    uint64_t                          frame{};
+    double                            frame_time{};
+    std::array<double, phase_count>   phase_seconds{};
+    std::array<uint64_t, phase_count> phase_allocations{};
+    uint64_t                          alloc_violations{};
+    uint64_t                          boids{};
+    uint64_t                          shots{};
+    uint64_t                          explosions{};
+    uint64_t                          lod_interval{};
+    uint64_t                          index_nodes{};
+    uint64_t                          index_depth{};
+    uint64_t                          index_occupied{};
+    uint64_t                          index_max_contents{};
+};
+
+constexpr size_t metrics_words = sizeof(metrics_sample) / sizeof(uint64_t);
+static_assert(sizeof(metrics_sample) == metrics_words * sizeof(uint64_t));
+
+// Sequence lock: the writer makes sequence odd, stores the words and makes
+// it even again. Readers retry until they see the same even sequence before
+// and after copying.
+struct metrics_segment {
+    uint32_t                            magic;
+    uint32_t                            version;
+    std::atomic<uint64_t>               sequence;
+    std::array<uint64_t, metrics_words> words;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+// A whole walk of the boid tree takes too long to do every frame, this does
+// a slice of it per frame. The stats given are from the last complete pass.
+class index_sampler {
+    quad_tree_stats m_partial;
+    quad_tree_stats m_complete;
+    size_t          m_slice{};
+
+  public:
+    auto sample(entity_tree const &tree) -> quad_tree_stats const &;
+};
+
+auto metrics_of(state &st, index_sampler &index) -> metrics_sample;
+
+// The segment is created by the writer and removed when it goes. If another
+// writer has the name, this one takes name-<pid> instead and says so on
+// stderr. A writer that couldn't create either publishes nothing.
+class metrics_writer {
+    std::string      m_name;
+    metrics_segment *m_segment{};
+
+    auto create(std::string const &name) -> bool;
+
+  public:
+    explicit metrics_writer(char const *name);
+    metrics_writer(metrics_writer const &)                     = delete;
+    auto operator=(metrics_writer const &) -> metrics_writer & = delete;
+    ~metrics_writer();
+
+    [[nodiscard]] auto is_open() const -> bool { return m_segment != nullptr; }
+    [[nodiscard]] auto name() const -> std::string const & { return m_name; }
+
+    // Never blocks and never allocates.
+    void publish(metrics_sample const &s);
+};
+
+class metrics_reader {
+    metrics_segment *m_segment{};
+
+  public:
+    explicit metrics_reader(char const *name);
+    metrics_reader(metrics_reader const &)                     = delete;
+    auto operator=(metrics_reader const &) -> metrics_reader & = delete;
+    ~metrics_reader();
+
+    // False when there is no segment of this version under the name.
+    [[nodiscard]] auto is_open() const -> bool { return m_segment != nullptr; }
+
+    // Copies the latest sample, false if the writer kept getting in the way.
+    auto read(metrics_sample &s) const -> bool;
+};
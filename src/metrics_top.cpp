@@ -0,0 +1,102 @@
+// Tails the live metrics of a running flox, one line per interval.
+//
+//   flox_top [--name NAME] [--interval MS]
+//
+// NAME defaults to $FLOX_METRICS, then to metrics_default_name, as in flox.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "metrics.h"
+
+namespace {
+
+constexpr long default_interval_ms = 1000;
+
+struct options {
+    char const *name{metrics_default_name};
+    long        interval_ms{default_interval_ms};
+};
+
+auto parse(int argc, char **argv) -> options {
+    options     opt;
+    char const *env = std::getenv("FLOX_METRICS"); // NOLINT
+    if(env != nullptr) {
+        opt.name = env;
+    }
+    for(int i = 1; i + 1 < argc; i += 2) {
+        std::string_view arg{argv[i]};
+        if(arg == "--name") {
+            opt.name = argv[i + 1];
+        } else if(arg == "--interval") {
+            opt.interval_ms = std::max(1L, std::atol(argv[i + 1]));
+        }
+    }
+    return opt;
+}
+
+void print_header() {
+    fmt::print("{:>8} {:>7}", "frame", "fps");
+    for(auto const *name : phase_names) {
+        fmt::print(" {:>6}", name);
+    }
+    fmt::print(" {:>6} {:>4} {:>4} {:>3} {:>6} {:>5} {:>6} {:>4} {:>6} {:>4}\n",
+               "boids", "shot", "expl", "lod", "nodes", "depth", "occup",
+               "max", "alloc", "viol");
+}
+
+void print(metrics_sample const &s) {
+    fmt::print("{:>8} {:>7.1f}", s.frame,
+               s.frame_time > 0 ? 1.0 / s.frame_time : 0.0);
+    for(double seconds : s.phase_seconds) {
+        fmt::print(" {:>6.3f}", seconds * 1000);
+    }
+    uint64_t allocations = 0;
+    for(auto count : s.phase_allocations) {
+        allocations += count;
+    }
+    fmt::print(" {:>6} {:>4} {:>4} {:>3} {:>6} {:>5} {:>6} {:>4} {:>6} {:>4}\n",
+               s.boids, s.shots, s.explosions, s.lod_interval, s.index_nodes,
+               s.index_depth, s.index_occupied, s.index_max_contents,
+               allocations, s.alloc_violations);
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    auto           opt = parse(argc, argv);
+    metrics_reader reader{opt.name};
+    if(!reader.is_open()) {
+        fmt::print(stderr, "no flox metrics at {}\n", opt.name);
+        return EXIT_FAILURE;
+    }
+
+    fmt::print("phase times in ms\n");
+    print_header();
+    metrics_sample last;
+    bool           stalled = false;
+    while(true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.interval_ms));
+        metrics_sample s;
+        if(!reader.read(s)) {
+            continue;
+        }
+        if(s.frame == last.frame) {
+            if(!stalled) {
+                fmt::print("no new frames\n");
+            }
+            stalled = true;
+            continue;
+        }
+        stalled = false;
+        last    = s;
+        print(s);
+        std::fflush(stdout);
+    }
+}
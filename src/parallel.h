@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Runs f(i) for every i in [0, n), split in contiguous chunks over up to
+// threads threads. The calling thread takes the first chunk.
+template <typename F>
+void parallel_for(size_t n, F &&f,
+                  size_t threads = std::thread::hardware_concurrency()) {
+    if(n == 0) {
+        return;
+    }
+    threads      = std::clamp<size_t>(threads, 1, n);
+    size_t chunk = (n + threads - 1) / threads;
+    auto   run   = [&f, n, chunk](size_t t) {
+        for(size_t i = t * chunk; i < std::min(n, (t + 1) * chunk); ++i) {
+            f(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for(size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(run, t);
+    }
+    run(0);
+    for(auto &w : workers) {
+        w.join();
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+// Single producer, single consumer ring buffer. N must be a power of two.
+template <typename T, size_t N> class spsc_queue {
+    static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+    std::array<T, N>                 m_items{};
+    alignas(64) std::atomic<size_t> m_head{};
+    alignas(64) std::atomic<size_t> m_tail{};
+
+  public:
+    auto push(T const &item) -> bool {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        m_items[tail % N] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    auto pop() -> std::optional<T> {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        T item = m_items[head % N];
+        m_head.store(head + 1, std::memory_order_release);
+        return item;
+    }
+};
+
+// Hands complete frames from one writer thread to one reader thread. The
+// writer always has a slot to fill and the reader always sees the latest
+// published one, neither ever waits for the other.
+template <typename T> class triple_buffer {
+    static constexpr uint8_t index_mask = 0x3;
+    static constexpr uint8_t fresh_bit  = 0x4;
+
+    std::array<T, 3>     m_slots{};
+    std::atomic<uint8_t> m_middle{1};
+    uint8_t              m_write{0};
+    uint8_t              m_read{2};
+
+  public:
+    auto write_slot() -> T & { return m_slots[m_write]; }
+
+    void publish() {
+        auto published = static_cast<uint8_t>(m_write | fresh_bit);
+        m_write        = static_cast<uint8_t>(
+            m_middle.exchange(published, std::memory_order_acq_rel) &
+            index_mask);
+    }
+
+    // Swaps in the latest published slot, if there is one newer than the
+    // current read slot.
+    auto acquire() -> bool {
+        if((m_middle.load(std::memory_order_relaxed) & fresh_bit) == 0) {
+            return false;
+        }
+        m_read = static_cast<uint8_t>(
+            m_middle.exchange(m_read, std::memory_order_acq_rel) & index_mask);
+        return true;
+    }
+
+    auto read_slot() -> T & { return m_slots[m_read]; }
+};
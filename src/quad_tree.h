@@ -1,58 +1,341 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <list>
+#include <memory>
+#include <span>
+#include <utility>
 #include <vector>
 
 #include "rect.h"
 
-template <typename A, typename B> struct quad_node_object;
-template <typename A, typename C> struct quad_tree_location;
-template <typename A, typename D> struct quad_tree_object_location;
+template <typename A, typename B, typename S, typename H>
+struct quad_node_object;
+template <typename A, typename C, typename S, typename H>
+struct quad_tree_location;
+template <typename A, typename D, typename S, typename H>
+struct quad_tree_object_location;
 
-template <typename T, typename Object> struct quad_node_object {
-    Object  obj;
-    rect<T> obj_rect;
+// Per node aggregate for trees that don't need one. A summary type provides
+// of() for a single object and += / -= to fold summaries together.
+struct no_summary {
+    template <typename Object, typename Shape>
+    static auto of(Object const & /*obj*/, Shape const & /*obj_shape*/)
+        -> no_summary {
+        return {};
+    }
+    auto operator+=(no_summary const & /*s*/) -> no_summary & { return *this; }
+    auto operator-=(no_summary const & /*s*/) -> no_summary & { return *this; }
+};
+
+enum class fold_action { skip, take, descend };
+
+// Trees keep a shape per object, a rect by default or just a point. Points
+// go strictly to the node they are in, and queries test them by containment
+// rather than overlap. These are all a tree needs to know of either.
+template <typename T> auto shape_centre(rect<T> const &r) -> vec2d_t<T> {
+    return r.position + r.size / 2;
+}
+template <typename T> auto shape_centre(vec2d_t<T> const &p) -> vec2d_t<T> {
+    return p;
+}
+
+template <typename T> auto shape_origin(rect<T> const &r) -> vec2d_t<T> {
+    return r.position;
+}
+template <typename T> auto shape_origin(vec2d_t<T> const &p) -> vec2d_t<T> {
+    return p;
+}
+
+template <typename T>
+auto shape_fits(rect<T> const &bounds, rect<T> const &r) -> bool {
+    return bounds.contains(r);
+}
+template <typename T>
+auto shape_fits(rect<T> const &bounds, vec2d_t<T> const &p) -> bool {
+    auto const &lo = bounds.position;
+    auto const  hi = bounds.position + bounds.size;
+    return p.x >= lo.x && p.y >= lo.y && p.x < hi.x && p.y < hi.y;
+}
+
+template <typename T>
+auto shape_hit(rect<T> const &query, rect<T> const &r) -> bool {
+    return query.overlaps(r);
+}
+template <typename T>
+auto shape_hit(rect<T> const &query, vec2d_t<T> const &p) -> bool {
+    return shape_fits(query, p);
+}
+
+template <typename T>
+auto shape_distance_sq(rect<T> const &r, vec2d_t<T> const &p) -> T {
+    auto const &lo = r.position;
+    auto const  hi = r.position + r.size;
+    vec2d_t<T>  nearest{std::clamp(p.x, lo.x, hi.x),
+                       std::clamp(p.y, lo.y, hi.y)};
+    return (nearest - p).mag_sq();
+}
+template <typename T>
+auto shape_distance_sq(vec2d_t<T> const &q, vec2d_t<T> const &p) -> T {
+    return (q - p).mag_sq();
+}
+template <typename T>
+auto shape_distance_sq(rect<T> const &a, rect<T> const &b) -> T {
+    auto gap = [](T lo_a, T hi_a, T lo_b, T hi_b) {
+        return std::max({T{}, lo_b - hi_a, lo_a - hi_b});
+    };
+    T dx = gap(a.position.x, a.position.x + a.size.x, b.position.x,
+               b.position.x + b.size.x);
+    T dy = gap(a.position.y, a.position.y + a.size.y, b.position.y,
+               b.position.y + b.size.y);
+    return dx * dx + dy * dy;
+}
 
-    quad_node_object(Object const &o, rect<T> const &r) : obj{o}, obj_rect{r} {}
+// Shape of the occupied part of a tree: nodes with objects in or below them,
+// the deepest of those, and how objects spread over the nodes holding any.
+struct quad_tree_stats {
+    size_t nodes{};
+    size_t depth{};
+    size_t occupied{};
+    size_t max_contents{};
 };
 
-template <typename T, typename Object> struct quad_tree_location {
-    std::list<quad_node_object<T, Object>>                   *cont{};
-    typename std::list<quad_node_object<T, Object>>::iterator iter{};
+template <typename T, typename Object, typename Summary = no_summary,
+          typename Shape = rect<T>>
+struct quad_node_object {
+    Object                        obj;
+    Shape                         shape;
+    [[no_unique_address]] Summary sample;
 
-    quad_tree_location(
-        std::list<quad_node_object<T, Object>>                   *cont,
-        typename std::list<quad_node_object<T, Object>>::iterator iter)
+    quad_node_object(Object const &o, Shape const &sh, Summary const &s)
+        : obj{o}, shape{sh}, sample{s} {}
+};
+
+template <typename T, typename Object, typename Summary = no_summary,
+          typename Shape = rect<T>>
+struct quad_tree_location {
+    using list = std::list<quad_node_object<T, Object, Summary, Shape>>;
+
+    list                    *cont{};
+    typename list::iterator iter{};
+
+    quad_tree_location(list *cont, typename list::iterator iter)
         : cont(cont), iter(iter) {}
     quad_tree_location() = default;
 };
 
-template <typename T, typename Object> struct quad_tree_object_location {
-    using container =
-        std::vector<std::optional<quad_tree_object_location<T, Object>>>;
-    using container_iter = typename container::iterator;
+// Names an object in a dynamic_quad_tree for as long as it is there, however
+// the storage is grown or reordered. A slot's generation changes when its
+// object is removed, which is how handles to removed objects are told apart.
+struct quad_tree_handle {
+    uint32_t index{};
+    uint32_t generation{};
 
-    Object                                object;
-    quad_tree_location<T, container_iter> location;
+    auto operator==(quad_tree_handle const &) const -> bool = default;
+};
+
+template <typename T, typename Object, typename Summary = no_summary,
+          typename Shape = rect<T>>
+struct quad_tree_object_location {
+    Object                                                  object;
+    quad_tree_location<T, quad_tree_handle, Summary, Shape> location;
+    quad_tree_handle                                        handle;
 
-    explicit quad_tree_object_location(Object const &obj) : object{obj} {}
-    explicit quad_tree_object_location(
-        Object const &obj, quad_tree_location<T, container_iter> const &loc)
-        : object{obj}, location{loc} {}
-    quad_tree_object_location() = default;
+    quad_tree_object_location(Object const &obj, quad_tree_handle h)
+        : object{obj}, handle{h} {}
 };
 
-template <typename T, typename Object> class quad_node {
-    std::list<quad_node_object<T, Object>>               m_contents{};
-    rect<T>                                              m_rect;
-    std::array<rect<T>, 4>                               m_child_rects;
-    std::array<std::shared_ptr<quad_node<T, Object>>, 4> m_children;
-    size_t                                               m_depth;
-    size_t                                               m_max_depth;
+template <typename T, typename Object, typename Summary = no_summary,
+          typename Shape = rect<T>>
+class quad_node {
+    using node     = quad_node<T, Object, Summary, Shape>;
+    using location = quad_tree_location<T, Object, Summary, Shape>;
+
+    static constexpr size_t no_child = 4;
+
+    std::list<quad_node_object<T, Object, Summary, Shape>> m_contents{};
+    rect<T>                                                m_rect;
+    rect<T>                                                m_bounds;
+    std::array<rect<T>, 4>                                 m_child_rects;
+    std::array<rect<T>, 4>                                 m_child_bounds;
+    std::array<std::shared_ptr<node>, 4>                   m_children;
+    size_t                                                 m_depth;
+    size_t                                                 m_max_depth;
+    T                                                      m_looseness;
+    size_t                                                 m_count{};
+    Summary                                                m_summary{};
+
+    static auto loosen(rect<T> const &r, T looseness) -> rect<T> {
+        return {r.position - r.size * (looseness - 1) / 2, r.size * looseness};
+    }
+
+    // The child under the centre of obj_shape, if its bounds hold all of it.
+    auto child_index(Shape const &obj_shape) const -> size_t {
+        if(m_depth >= m_max_depth) {
+            return no_child;
+        }
+        auto   centre = shape_centre(obj_shape);
+        auto   split  = m_rect.position + m_rect.size / 2;
+        size_t i      = centre.x < split.x ? 0 : 1;
+        i             += centre.y < split.y ? 0 : 2;
+        return shape_fits(m_child_bounds[i], obj_shape) ? i : no_child;
+    }
+
+    auto child(size_t i) -> node & {
+        if(!m_children[i]) {
+            m_children[i] = std::make_shared<node>(
+                m_child_rects[i], m_depth + 1, m_max_depth, m_looseness);
+        }
+        return *m_children[i];
+    }
+
+    auto place(Object const &obj, Shape const &obj_shape,
+               Summary const &sample) -> location {
+        size_t i = child_index(obj_shape);
+        if(i == no_child) {
+            m_contents.emplace_back(obj, obj_shape, sample);
+            return {&m_contents, std::prev(m_contents.end())};
+        }
+        return child(i).insert(obj, obj_shape, sample);
+    }
+
+    // Takes an entry out of the count and summary of every node from here to
+    // the one holding it, leaving it in its list.
+    void detach(location const &loc) {
+        --m_count;
+        m_summary -= loc.iter->sample;
+        if(loc.cont != &m_contents) {
+            m_children[child_index(loc.iter->shape)]->detach(loc);
+        }
+    }
+
+    // Counterpart of detach(), splicing the entry over from whichever list it
+    // is in to the node its shape now places it in.
+    auto attach(location const &loc) -> location {
+        ++m_count;
+        m_summary += loc.iter->sample;
+        size_t i = child_index(loc.iter->shape);
+        if(i == no_child) {
+            m_contents.splice(m_contents.end(), *loc.cont, loc.iter);
+            return {&m_contents, loc.iter};
+        }
+        return child(i).attach(loc);
+    }
+
+    // insert_range() for one node. The entries are counted per child and
+    // then scattered into spare, child by child, so every entry is read and
+    // written once per level and always in sequence. spare and entries swap
+    // roles on the way down.
+    template <typename Entry, typename Store, typename Placed>
+    void place_range(std::span<Entry> entries, std::span<Entry> spare,
+                     std::span<uint8_t> slots, Store &store, Placed &placed) {
+        m_count += entries.size();
+        std::array<size_t, no_child + 1> starts{};
+        for(size_t k = 0; k < entries.size(); ++k) {
+            m_summary += entries[k].sample;
+            slots[k]  = static_cast<uint8_t>(child_index(entries[k].shape));
+            ++starts[slots[k]];
+        }
+        for(size_t b = 0, start = 0; b <= no_child; ++b) {
+            size_t n  = starts[b];
+            starts[b] = start;
+            start     += n;
+        }
+        auto next = starts;
+        for(size_t k = 0; k < entries.size(); ++k) {
+            if(slots[k] == no_child) {
+                auto obj = store(entries[k]);
+                m_contents.emplace_back(obj, entries[k].shape,
+                                        entries[k].sample);
+                placed(obj, location{&m_contents, std::prev(m_contents.end())});
+            } else {
+                spare[next[slots[k]]++] = std::move(entries[k]);
+            }
+        }
+        for(size_t i = 0; i < no_child; ++i) {
+            size_t n = next[i] - starts[i];
+            if(n > 0) {
+                child(i).place_range(
+                    spare.subspan(starts[i], n), entries.subspan(starts[i], n),
+                    slots.subspan(starts[i], n), store, placed);
+            }
+        }
+    }
+
+    auto live(size_t i) const -> bool {
+        return m_children[i] && m_children[i]->m_count > 0;
+    }
+
+    // f(obj, other, distance_sq) for every other object in this subtree
+    // nearer than radius to p, where obj is.
+    template <typename F>
+    void pairs_with(Object const &obj, vec2d_t<T> const &p, T radius_sq,
+                    F &f) const {
+        for(auto const &qno : m_contents) {
+            T d = shape_distance_sq(shape_centre(qno.shape), p);
+            if(d < radius_sq) {
+                f(obj, qno.obj, d);
+            }
+        }
+        for(size_t i = 0; i < 4; ++i) {
+            if(live(i) &&
+               shape_distance_sq(m_children[i]->m_bounds, p) < radius_sq) {
+                m_children[i]->pairs_with(obj, p, radius_sq, f);
+            }
+        }
+    }
+
+    // The pairs in range that have an object held here: with each other and
+    // with the subtrees below.
+    template <typename F> void contents_pairs(T radius_sq, F &f) const {
+        for(auto a = m_contents.begin(); a != m_contents.end(); ++a) {
+            auto p = shape_centre(a->shape);
+            for(auto b = std::next(a); b != m_contents.end(); ++b) {
+                T d = shape_distance_sq(shape_centre(b->shape), p);
+                if(d < radius_sq) {
+                    f(a->obj, b->obj, d);
+                }
+            }
+            for(size_t i = 0; i < 4; ++i) {
+                if(live(i) &&
+                   shape_distance_sq(m_children[i]->m_bounds, p) < radius_sq) {
+                    m_children[i]->pairs_with(a->obj, p, radius_sq, f);
+                }
+            }
+        }
+    }
+
+    // The pairs in range between this subtree and other, a node at the same
+    // depth, that have an object held in either of the two.
+    template <typename F>
+    void contents_pairs_across(quad_node const &other, T radius_sq,
+                               F &f) const {
+        for(auto const &qno : m_contents) {
+            other.pairs_with(qno.obj, shape_centre(qno.shape), radius_sq, f);
+        }
+        for(auto const &qno : other.m_contents) {
+            auto p = shape_centre(qno.shape);
+            for(size_t i = 0; i < 4; ++i) {
+                if(live(i) &&
+                   shape_distance_sq(m_children[i]->m_bounds, p) < radius_sq) {
+                    m_children[i]->pairs_with(qno.obj, p, radius_sq, f);
+                }
+            }
+        }
+    }
 
   public:
-    quad_node(rect<T> const &rect, size_t depth, size_t max_depth)
-        : m_rect{rect}, m_depth{depth}, m_max_depth(max_depth) {
+    // A looseness above 1 makes this a loose quad tree: each node's bounds
+    // are its rect grown by that factor around its centre, and objects go to
+    // the child under their centre when they fit in its bounds. Objects then
+    // only stay high up in the tree for being large, not for straddling a
+    // split line.
+    quad_node(rect<T> const &rect, size_t depth, size_t max_depth,
+              T looseness = 1)
+        : m_rect{rect}, m_bounds{loosen(rect, looseness)}, m_depth{depth},
+          m_max_depth(max_depth), m_looseness{looseness} {
         vec2d_t<T> child_size = m_rect.size / 2;
         m_child_rects[0]      = {m_rect.position, child_size};
         m_child_rects[1]      = {m_rect.position + vec2d_t<T>{child_size.x, 0},
@@ -60,6 +343,9 @@ template <typename T, typename Object> class quad_node {
         m_child_rects[2]      = {m_rect.position + vec2d_t<T>{0, child_size.y},
                                  child_size};
         m_child_rects[3]      = {m_rect.position + child_size, child_size};
+        for(size_t i = 0; i < 4; ++i) {
+            m_child_bounds[i] = loosen(m_child_rects[i], looseness);
+        }
     }
     quad_node(quad_node const &)                         = delete;
     quad_node(quad_node &&) noexcept                     = default;
@@ -67,46 +353,75 @@ template <typename T, typename Object> class quad_node {
     auto operator=(quad_node &&) noexcept -> quad_node & = default;
     ~quad_node()                                         = default;
 
-    auto insert(Object const &obj, rect<T> const &obj_rect)
-        -> quad_tree_location<T, Object> {
-        for(size_t i = 0; i < 4; ++i) {
-            if(m_child_rects[i].contains(obj_rect)) {
-                if(m_depth < m_max_depth) {
-                    if(!m_children[i]) {
-                        m_children[i] = std::make_shared<quad_node<T, Object>>(
-                            m_child_rects[i], m_depth + 1, m_max_depth);
-                    }
-                    return m_children[i]->insert(obj, obj_rect);
-                }
-            }
-        }
-        m_contents.emplace_back(obj, obj_rect);
-        return {&m_contents, std::prev(m_contents.end())};
+    auto insert(Object const &obj, Shape const &obj_shape,
+                Summary const &sample = {}) -> location {
+        ++m_count;
+        m_summary += sample;
+        return place(obj, obj_shape, sample);
     }
 
-    auto size() -> size_t {
-        size_t size = m_contents.size();
-        for(auto child : m_children) {
-            if(child.get() != nullptr) {
-                size += child->size();
-            }
+    // Places a batch in one pass down the tree. Each node takes the count and
+    // summary of the whole batch, keeps the entries that stop at it and sends
+    // the rest on to its children, creating each of them once. Entries have a
+    // shape and sample; store(entry) gives the Object to keep for one once
+    // its node is found and placed(obj, location) is then told where it went.
+    // Entries are placed depth first, node by node.
+    template <typename Entry, typename Store, typename Placed>
+    void insert_range(std::span<Entry> entries, Store &&store,
+                      Placed &&placed) {
+        std::vector<Entry>   spare{entries.begin(), entries.end()};
+        std::vector<uint8_t> slots(entries.size());
+        place_range(entries, std::span{spare}, std::span{slots}, store,
+                    placed);
+    }
+
+    // Walks down the path the object was placed along, so that every count
+    // and summary on the way is kept in step.
+    void erase(location const &loc) {
+        detach(loc);
+        loc.cont->erase(loc.iter);
+    }
+
+    // Only the part of the path that differs between old and new placement is
+    // touched, and the list node is spliced over rather than reallocated.
+    auto move(location const &loc, Shape const &obj_shape,
+              Summary const &sample) -> location {
+        auto &entry = *loc.iter;
+        m_summary   -= entry.sample;
+        m_summary   += sample;
+        size_t from =
+            loc.cont == &m_contents ? no_child : child_index(entry.shape);
+        size_t to = child_index(obj_shape);
+        if(from == to && from != no_child) {
+            return m_children[from]->move(loc, obj_shape, sample);
         }
-        return size;
+        if(from != no_child) {
+            m_children[from]->detach(loc);
+        }
+        entry.shape  = obj_shape;
+        entry.sample = sample;
+        if(to == no_child) {
+            m_contents.splice(m_contents.end(), *loc.cont, loc.iter);
+            return {&m_contents, loc.iter};
+        }
+        return child(to).attach(loc);
     }
 
-    auto size(rect<T> rect) -> size_t {
+    auto size() const -> size_t { return m_count; }
+
+    auto size(rect<T> rect) const -> size_t {
         size_t size = std::count_if(
             m_contents.cbegin(), m_contents.cend(),
-            [&rect](auto const &obj) { return rect.overlaps(obj.obj_rect); });
+            [&rect](auto const &obj) { return shape_hit(rect, obj.shape); });
         for(size_t i = 0; i < 4; ++i) {
-            if(!rect.overlaps(m_child_rects[i])) {
+            if(!m_children[i] || m_children[i]->m_count == 0) {
                 continue;
             }
-            if(m_children[i].get() == nullptr) {
+            if(!rect.overlaps(m_child_bounds[i])) {
                 continue;
             }
-            if(rect.contains(m_child_rects[i])) {
-                size += m_children[i]->size();
+            if(rect.contains(m_child_bounds[i])) {
+                size += m_children[i]->m_count;
                 continue;
             }
             size += m_children[i]->size(rect);
@@ -114,31 +429,102 @@ template <typename T, typename Object> class quad_node {
         return size;
     }
 
-    void items(std::vector<Object> &result) {
+    // Stops at the first object found.
+    auto any(rect<T> const &rect) const -> bool {
+        for(auto const &qno : m_contents) {
+            if(shape_hit(rect, qno.shape)) {
+                return true;
+            }
+        }
+        for(size_t i = 0; i < 4; ++i) {
+            if(!m_children[i] || m_children[i]->m_count == 0) {
+                continue;
+            }
+            if(!rect.overlaps(m_child_bounds[i])) {
+                continue;
+            }
+            if(rect.contains(m_child_bounds[i]) || m_children[i]->any(rect)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Creates every node below this one down to the maximum depth, so that
+    // objects moving about never allocate.
+    void build() {
+        if(m_depth >= m_max_depth) {
+            return;
+        }
+        for(size_t i = 0; i < 4; ++i) {
+            child(i).build();
+        }
+    }
+
+    void count_in(quad_tree_stats &s) const {
+        ++s.nodes;
+        s.depth = std::max(s.depth, m_depth);
+        if(!m_contents.empty()) {
+            ++s.occupied;
+            s.max_contents = std::max(s.max_contents, m_contents.size());
+        }
+    }
+
+    // Walks the non-empty subtrees only.
+    void stats(quad_tree_stats &s) const {
+        count_in(s);
+        for(auto const &c : m_children) {
+            if(c && c->m_count > 0) {
+                c->stats(s);
+            }
+        }
+    }
+
+    // One slice of stats(): the subtree of the slice'th node at split_depth,
+    // numbered in child order, plus the nodes above that depth for slice 0.
+    void stats(quad_tree_stats &s, size_t split_depth, size_t slice,
+               size_t path = 0) const {
+        if(m_depth == split_depth) {
+            if(path == slice) {
+                stats(s);
+            }
+            return;
+        }
+        if(slice == 0) {
+            count_in(s);
+        }
+        for(size_t i = 0; i < 4; ++i) {
+            if(m_children[i] && m_children[i]->m_count > 0) {
+                m_children[i]->stats(s, split_depth, slice, path * 4 + i);
+            }
+        }
+    }
+
+    void items(std::vector<Object> &result) const {
         for(auto const &qno : m_contents) {
             result.push_back(qno.obj);
         }
-        for(auto child : m_children) {
-            if(child.get()) {
-                child->items(result);
+        for(auto const &c : m_children) {
+            if(c && c->m_count > 0) {
+                c->items(result);
             }
         }
     }
 
-    void items(std::vector<Object> &result, rect<T> const &rect) {
-        for(auto qno : m_contents) {
-            if(qno.obj_rect.overlaps(rect)) {
+    void items(std::vector<Object> &result, rect<T> const &rect) const {
+        for(auto const &qno : m_contents) {
+            if(shape_hit(rect, qno.shape)) {
                 result.push_back(qno.obj);
             }
         }
         for(size_t i = 0; i < 4; ++i) {
-            if(m_children[i].get() == nullptr) {
+            if(!m_children[i] || m_children[i]->m_count == 0) {
                 continue;
             }
-            if(!rect.overlaps(m_child_rects[i])) {
+            if(!rect.overlaps(m_child_bounds[i])) {
                 continue;
             }
-            if(rect.contains(m_child_rects[i])) {
+            if(rect.contains(m_child_bounds[i])) {
                 m_children[i]->items(result);
                 continue;
             }
@@ -146,33 +532,248 @@ template <typename T, typename Object> class quad_node {
         }
     }
 
+    // Barnes-Hut style reduction. node_filter(rect, summary) decides whether a
+    // subtree is skipped, taken whole from its summary or opened up, in which
+    // case object_filter(shape, sample) picks among the objects held here.
+    template <typename NodeFilter, typename ObjectFilter>
+    void fold(Summary &acc, NodeFilter &&node_filter,
+              ObjectFilter &&object_filter) const {
+        switch(node_filter(m_bounds, m_summary)) {
+        case fold_action::skip:
+            return;
+        case fold_action::take:
+            acc += m_summary;
+            return;
+        case fold_action::descend:
+            break;
+        }
+        for(auto const &qno : m_contents) {
+            if(object_filter(qno.shape, qno.sample)) {
+                acc += qno.sample;
+            }
+        }
+        for(auto const &c : m_children) {
+            if(c && c->m_count > 0) {
+                c->fold(acc, node_filter, object_filter);
+            }
+        }
+    }
+
+    // Self-join: f(a, b, distance_sq) once for every unordered pair of
+    // objects in this subtree whose centres are nearer than radius. Pairs of
+    // subtrees that far apart are passed over whole.
+    template <typename F> void pairs(T radius_sq, F &f) const {
+        if(m_count < 2) {
+            return;
+        }
+        contents_pairs(radius_sq, f);
+        for(size_t i = 0; i < 4; ++i) {
+            if(!live(i)) {
+                continue;
+            }
+            m_children[i]->pairs(radius_sq, f);
+            for(size_t j = i + 1; j < 4; ++j) {
+                if(live(j)) {
+                    m_children[i]->pairs_across(*m_children[j], radius_sq, f);
+                }
+            }
+        }
+    }
+
+    // The pairs in range with one object in this subtree and one in other,
+    // a different node at the same depth. Both are split at once.
+    template <typename F>
+    void pairs_across(quad_node const &other, T radius_sq, F &f) const {
+        if(m_count == 0 || other.m_count == 0 ||
+           shape_distance_sq(m_bounds, other.m_bounds) >= radius_sq) {
+            return;
+        }
+        contents_pairs_across(other, radius_sq, f);
+        for(size_t i = 0; i < 4; ++i) {
+            for(size_t j = 0; j < 4; ++j) {
+                if(live(i) && other.live(j)) {
+                    m_children[i]->pairs_across(*other.m_children[j],
+                                                radius_sq, f);
+                }
+            }
+        }
+    }
+
+    // One slice of pairs(): those below the slice'th node at split_depth,
+    // numbered in child order, and those between it and its neighbours
+    // after it. Slice 0 also takes the pairs of objects held above.
+    template <typename F>
+    void pairs(T radius_sq, F &f, size_t split_depth, size_t slice,
+               size_t path = 0) const {
+        if(m_depth == split_depth) {
+            if(path == slice) {
+                pairs(radius_sq, f);
+            }
+            return;
+        }
+        if(m_count < 2) {
+            return;
+        }
+        if(slice == 0) {
+            contents_pairs(radius_sq, f);
+        }
+        for(size_t i = 0; i < 4; ++i) {
+            if(!live(i)) {
+                continue;
+            }
+            m_children[i]->pairs(radius_sq, f, split_depth, slice,
+                                 path * 4 + i);
+            for(size_t j = i + 1; j < 4; ++j) {
+                if(live(j)) {
+                    m_children[i]->pairs_across(*m_children[j], radius_sq, f,
+                                                split_depth, slice,
+                                                path * 4 + i);
+                }
+            }
+        }
+    }
+
+    template <typename F>
+    void pairs_across(quad_node const &other, T radius_sq, F &f,
+                      size_t split_depth, size_t slice, size_t path) const {
+        if(m_depth == split_depth) {
+            if(path == slice) {
+                pairs_across(other, radius_sq, f);
+            }
+            return;
+        }
+        if(m_count == 0 || other.m_count == 0 ||
+           shape_distance_sq(m_bounds, other.m_bounds) >= radius_sq) {
+            return;
+        }
+        if(slice == 0) {
+            contents_pairs_across(other, radius_sq, f);
+        }
+        for(size_t i = 0; i < 4; ++i) {
+            for(size_t j = 0; j < 4; ++j) {
+                if(live(i) && other.live(j)) {
+                    m_children[i]->pairs_across(*other.m_children[j],
+                                                radius_sq, f, split_depth,
+                                                slice, path * 4 + i);
+                }
+            }
+        }
+    }
+
+    using frontier = std::vector<std::pair<T, quad_node const *>>;
+
+    // Best-first search for the k objects nearest to p that accept(obj)
+    // takes. result is kept as a max-heap of (squared distance, object) at
+    // most k long and comes out sorted nearest first. Nodes wait in open by
+    // distance and the search stops once the nearest of them is no closer
+    // than the k'th best, so a search touches about k objects however
+    // crowded the tree is. Both vectors are only reused, not shrunk.
+    template <typename Accept>
+    void nearest(vec2d_t<T> const &p, size_t k,
+                 std::vector<std::pair<T, Object>> &result, frontier &open,
+                 Accept &&accept) const {
+        auto farther = [](auto const &a, auto const &b) {
+            return a.first > b.first;
+        };
+        auto nearer = [](auto const &a, auto const &b) {
+            return a.first < b.first;
+        };
+        auto beats = [&](T d) {
+            return result.size() < k || d < result.front().first;
+        };
+        result.clear();
+        open.clear();
+        if(k == 0 || m_count == 0) {
+            return;
+        }
+        open.emplace_back(shape_distance_sq(m_bounds, p), this);
+        while(!open.empty()) {
+            std::pop_heap(open.begin(), open.end(), farther);
+            auto [d, n] = open.back();
+            open.pop_back();
+            if(!beats(d)) {
+                break;
+            }
+            for(auto const &qno : n->m_contents) {
+                T od = shape_distance_sq(qno.shape, p);
+                if(!beats(od) || !accept(qno.obj)) {
+                    continue;
+                }
+                if(result.size() == k) {
+                    std::pop_heap(result.begin(), result.end(), nearer);
+                    result.pop_back();
+                }
+                result.emplace_back(od, qno.obj);
+                std::push_heap(result.begin(), result.end(), nearer);
+            }
+            for(auto const &c : n->m_children) {
+                if(!c || c->m_count == 0) {
+                    continue;
+                }
+                T cd = shape_distance_sq(c->m_bounds, p);
+                if(beats(cd)) {
+                    open.emplace_back(cd, c.get());
+                    std::push_heap(open.begin(), open.end(), farther);
+                }
+            }
+        }
+        std::sort_heap(result.begin(), result.end(), nearer);
+    }
+
+    // Where the objects in this subtree can be, wider than rect() when loose.
+    auto bounds() const -> rect<T> { return m_bounds; }
+
     auto rect() const -> rect<T> { return m_rect; }
+
+    auto summary() const -> Summary const & { return m_summary; }
 };
 
-template <typename T, typename Object> class static_quad_tree {
-    std::vector<Object>  m_objects;
-    size_t               m_max_objects;
-    size_t               m_max_depth;
-    quad_node<T, Object> m_root;
+template <typename T, typename Object, typename Summary = no_summary,
+          typename Shape = rect<T>>
+class static_quad_tree {
+    std::vector<Object>                  m_objects;
+    size_t                               m_max_objects;
+    size_t                               m_max_depth;
+    quad_node<T, Object, Summary, Shape> m_root;
 
   public:
-    static_quad_tree(rect<T> rect, size_t max_objects, size_t max_depth)
+    static_quad_tree(rect<T> rect, size_t max_objects, size_t max_depth,
+                     T looseness = 1)
         : m_max_objects{max_objects},
-          m_max_depth(max_depth), m_root{rect, 0, max_depth} {
+          m_max_depth(max_depth), m_root{rect, 0, max_depth, looseness} {
         m_objects.reserve(max_objects);
     }
 
-    void insert(Object const &obj, rect<T> const &obj_rect) {
+    void insert(Object const &obj, Shape const &obj_shape) {
         m_objects.emplace_back(obj);
-        m_root.insert(obj, obj_rect);
+        m_root.insert(obj, obj_shape, Summary::of(obj, obj_shape));
+    }
+
+    // Inserts objs in one pass down the tree, shape_of(obj) gives the shape
+    // of each.
+    template <typename Range, typename ShapeOf>
+    void insert_range(Range const &objs, ShapeOf &&shape_of) {
+        std::vector<quad_node_object<T, Object, Summary, Shape>> batch;
+        batch.reserve(std::size(objs));
+        for(auto const &obj : objs) {
+            auto sh = shape_of(obj);
+            m_objects.emplace_back(obj);
+            batch.emplace_back(obj, sh, Summary::of(obj, sh));
+        }
+        m_root.insert_range(
+            std::span{batch}, [](auto const &entry) { return entry.obj; },
+            [](auto const & /*obj*/, auto const & /*loc*/) {});
     }
 
     auto size() -> size_t { return m_objects.size(); }
 
     auto size(rect<T> rect) {
-        return rect.contains(m_root.rect()) ? m_root.size() : m_root.size(rect);
+        return rect.contains(m_root.bounds()) ? m_root.size()
+                                              : m_root.size(rect);
     }
 
+    auto any(rect<T> const &rect) const -> bool { return m_root.any(rect); }
+
     auto items() -> std::vector<Object> const & { return m_objects; }
 
     auto items(rect<T> rect) -> std::vector<Object> {
@@ -180,91 +781,295 @@ template <typename T, typename Object> class static_quad_tree {
         m_root.items(result, rect);
         return result;
     }
+
+    // Replaces the contents of result, so its storage can be reused.
+    void items(std::vector<Object> &result, rect<T> rect) const {
+        result.clear();
+        m_root.items(result, rect);
+    }
+
+    template <typename NodeFilter, typename ObjectFilter>
+    auto fold(NodeFilter &&node_filter, ObjectFilter &&object_filter) const
+        -> Summary {
+        Summary acc{};
+        m_root.fold(acc, node_filter, object_filter);
+        return acc;
+    }
 };
 
-template <typename T, typename Object> class dynamic_quad_tree {
+template <typename T, typename Object, typename Summary = no_summary,
+          typename Shape = rect<T>>
+class dynamic_quad_tree {
   public:
-    using container =
-        std::vector<std::optional<quad_tree_object_location<T, Object>>>;
-    using container_iter  = typename container::iterator;
-    using container_citer = typename container::const_iterator;
+    using handle = quad_tree_handle;
 
   private:
-    container                    m_objects;
-    size_t                       m_max_objects;
-    size_t                       m_max_depth;
-    quad_node<T, container_iter> m_root;
-    std::vector<container_iter>  m_removed_objects{};
+    using entry = quad_tree_object_location<T, Object, Summary, Shape>;
+
+    static constexpr uint32_t no_object = UINT32_MAX;
+
+    // Where a handle's object is in m_objects, no_object while the slot is
+    // free.
+    struct slot {
+        uint32_t generation{};
+        uint32_t object{no_object};
+    };
+
+    // Objects are kept densely packed, slots map handles onto them.
+    std::vector<entry>                   m_objects;
+    std::vector<slot>                    m_slots;
+    std::vector<uint32_t>                m_free_slots;
+    size_t                               m_max_depth;
+    quad_node<T, handle, Summary, Shape> m_root;
 
   public:
-    dynamic_quad_tree(rect<T> rect, size_t max_objects, size_t max_depth)
-        : m_max_objects{max_objects},
-          m_max_depth(max_depth), m_root{rect, 0, max_depth} {
-        m_objects.reserve(max_objects);
+    // capacity is only reserved up front, the storage grows past it.
+    dynamic_quad_tree(rect<T> rect, size_t capacity, size_t max_depth,
+                      T looseness = 1)
+        : m_max_depth(max_depth), m_root{rect, 0, max_depth, looseness} {
+        reserve(capacity);
     }
 
-    [[nodiscard]] auto has_room() const -> bool {
-        return m_objects.size() < m_max_objects || m_removed_objects.size() > 0;
+    void reserve(size_t capacity) {
+        m_objects.reserve(capacity);
+        m_slots.reserve(capacity);
+        m_free_slots.reserve(capacity);
     }
 
-    void insert(Object const &obj, rect<T> const &obj_rect) {
-        if(!has_room()) {
-            throw std::runtime_error{"quad tree full"};
-        }
-        if(m_objects.size() < m_max_objects) {
-            m_objects.emplace_back(obj);
-            m_objects.back()->location =
-                m_root.insert(std::prev(m_objects.end()), obj_rect);
-            return;
+    // Builds all nodes up front instead of as objects first reach them.
+    void preallocate_nodes() { m_root.build(); }
+
+    auto insert(Object const &obj, Shape const &obj_shape) -> handle {
+        handle h = claim(obj);
+        m_objects.back().location =
+            m_root.insert(h, obj_shape, Summary::of(obj, obj_shape));
+        return h;
+    }
+
+    // Inserts objs in one pass down the tree, shape_of(obj) gives the shape
+    // of each. Faster than inserting one at a time for large batches.
+    template <typename Range, typename ShapeOf>
+    void insert_range(Range const &objs, ShapeOf &&shape_of) {
+        std::vector<quad_node_object<T, Object, Summary, Shape>> batch;
+        batch.reserve(std::size(objs));
+        for(auto const &obj : objs) {
+            auto sh = shape_of(obj);
+            batch.emplace_back(obj, sh, Summary::of(obj, sh));
         }
-        container_iter iter = m_removed_objects.back();
-        m_removed_objects.pop_back();
-        *iter = quad_tree_object_location{obj, m_root.insert(iter, obj_rect)};
+        reserve(m_objects.size() + batch.size());
+        // storage is claimed in placement order, which keeps it spatially
+        // sorted as far as the batch goes
+        m_root.insert_range(
+            std::span{batch},
+            [this](auto const &e) { return claim(e.obj); },
+            [this](handle h, auto const &loc) {
+                m_objects[m_slots[h.index].object].location = loc;
+            });
+    }
+
+    // False once the object is removed, even if its slot has been reused.
+    [[nodiscard]] auto contains(handle h) const -> bool {
+        return h.index < m_slots.size() &&
+               m_slots[h.index].generation == h.generation &&
+               m_slots[h.index].object != no_object;
     }
 
-    auto size() -> size_t {
-        return m_objects.size() - m_removed_objects.size();
+    // Checked access, nullptr for handles to removed objects.
+    auto get(handle h) -> Object * {
+        return contains(h) ? &m_objects[m_slots[h.index].object].object
+                           : nullptr;
     }
 
+    // Unchecked access, h has to be live.
+    auto operator[](handle h) -> Object & {
+        return m_objects[m_slots[h.index].object].object;
+    }
+
+    auto size() const -> size_t { return m_objects.size(); }
+
     auto size(rect<T> rect) -> size_t {
-        return rect.contains(m_root.rect()) ? m_root.size() : m_root.size(rect);
+        return rect.contains(m_root.bounds()) ? m_root.size()
+                                              : m_root.size(rect);
     }
 
+    auto any(rect<T> const &rect) const -> bool { return m_root.any(rect); }
+
     [[nodiscard]] auto empty() const -> bool { return m_objects.empty(); }
 
-    auto items() -> std::vector<container_iter> {
-        std::vector<container_iter> result;
-        for(auto const &o : m_objects) {
-            if(o) {
-                result.emplace_back(o->location.iter->obj);
-            }
-        }
+    auto items() -> std::vector<handle> {
+        std::vector<handle> result;
+        items(result);
+        return result;
+    }
+
+    auto items(rect<T> rect) -> std::vector<handle> {
+        std::vector<handle> result;
+        items(result, rect);
         return result;
     }
 
-    auto items(rect<T> rect) -> std::vector<container_iter> {
-        if(rect.contains(m_root.rect())) {
-            return items();
+    // Both replace the contents of result, so its storage can be reused.
+    void items(std::vector<handle> &result) const {
+        result.clear();
+        for(auto const &e : m_objects) {
+            result.push_back(e.handle);
+        }
+    }
+
+    void items(std::vector<handle> &result, rect<T> rect) const {
+        if(rect.contains(m_root.bounds())) {
+            items(result);
+            return;
         }
-        std::vector<container_iter> result;
+        result.clear();
         m_root.items(result, rect);
-        return result;
     }
 
-    void remove(container_iter &iter) {
-        if(!*iter) {
+    // The last object takes the place of the removed one, so the storage
+    // stays dense. Handles stay valid throughout.
+    void remove(handle h) {
+        if(!contains(h)) {
             return;
         }
-        (*iter)->location.cont->erase((*iter)->location.iter);
-        m_removed_objects.push_back(iter);
-        *iter = std::nullopt;
+        auto &s = m_slots[h.index];
+        m_root.erase(m_objects[s.object].location);
+        if(s.object + 1 != m_objects.size()) {
+            m_objects[s.object] = std::move(m_objects.back());
+            m_slots[m_objects[s.object].handle.index].object = s.object;
+        }
+        m_objects.pop_back();
+        s.object = no_object;
+        ++s.generation;
+        m_free_slots.push_back(h.index);
     }
 
-    void move(container_iter &iter, rect<T> const &rect) {
-        if(!*iter) {
+    void move(handle h, Shape const &obj_shape) {
+        if(!contains(h)) {
             return;
         }
-        (*iter)->location.cont->erase((*iter)->location.iter);
-        (*iter)->location = m_root.insert(iter, rect);
+        auto &e    = m_objects[m_slots[h.index].object];
+        e.location = m_root.move(e.location, obj_shape,
+                                 Summary::of(e.object, obj_shape));
+    }
+
+    auto summary() const -> Summary const & { return m_root.summary(); }
+
+    // Handles index below this, for arrays kept by handle index.
+    auto slots() const -> size_t { return m_slots.size(); }
+
+    // Every unordered pair of objects whose centres are nearer than radius,
+    // once each as f(a, b, distance_sq) with their handles. Every pair in
+    // range is compared once, where a query per object compares it twice.
+    template <typename F> void pairs(T radius, F &&f) const {
+        m_root.pairs(radius * radius, f);
+    }
+
+    // pairs() spread over pair_slices calls, each giving its share. The
+    // slices can run at once.
+    static constexpr size_t pair_split_depth = 2;
+    static constexpr size_t pair_slices      = 16;
+
+    template <typename F> void pairs(T radius, F &&f, size_t slice) const {
+        m_root.pairs(radius * radius, f, pair_split_depth, slice);
+    }
+
+    using neighbour = std::pair<T, handle>;
+    using knn_frontier =
+        typename quad_node<T, handle, Summary, Shape>::frontier;
+
+    // The k nearest objects to p, as (squared distance, handle) nearest
+    // first, skipping those accept(handle) turns down. open is scratch.
+    template <typename Accept>
+    void nearest(vec2d_t<T> const &p, size_t k, std::vector<neighbour> &result,
+                 knn_frontier &open, Accept &&accept) const {
+        m_root.nearest(p, k, result, open, accept);
+    }
+
+    void nearest(vec2d_t<T> const &p, size_t k, std::vector<neighbour> &result,
+                 knn_frontier &open) const {
+        nearest(p, k, result, open, [](handle /*h*/) { return true; });
+    }
+
+    auto stats() const -> quad_tree_stats {
+        quad_tree_stats s;
+        if(!empty()) {
+            m_root.stats(s);
+        }
+        return s;
+    }
+
+    // stats() spread over stats_slices calls, each adding its part to s.
+    static constexpr size_t stats_split_depth = 2;
+    static constexpr size_t stats_slices      = 16;
+
+    void add_stats(quad_tree_stats &s, size_t slice) const {
+        if(!empty()) {
+            m_root.stats(s, stats_split_depth, slice);
+        }
+    }
+
+    template <typename NodeFilter, typename ObjectFilter>
+    auto fold(NodeFilter &&node_filter, ObjectFilter &&object_filter) const
+        -> Summary {
+        Summary acc{};
+        m_root.fold(acc, node_filter, object_filter);
+        return acc;
+    }
+
+    // Reorders the storage along a Z-order curve, so that objects close in
+    // space are close in memory. Handles stay valid, lists of them taken
+    // before come out in a different order.
+    void sort_spatially() {
+        auto key = [this](entry const &e) {
+            return z_order(shape_origin(e.location.iter->shape));
+        };
+        std::sort(m_objects.begin(), m_objects.end(),
+                  [&key](auto const &a, auto const &b) {
+                      return key(a) < key(b);
+                  });
+        for(size_t i = 0; i < m_objects.size(); ++i) {
+            m_slots[m_objects[i].handle.index].object =
+                static_cast<uint32_t>(i);
+        }
+    }
+
+  private:
+    // Storage and a handle for a new object, reusing a free slot if there is
+    // one. Its location is left for the caller to fill in.
+    auto claim(Object const &obj) -> handle {
+        if(m_free_slots.empty()) {
+            m_free_slots.push_back(static_cast<uint32_t>(m_slots.size()));
+            m_slots.emplace_back();
+        }
+        uint32_t index = m_free_slots.back();
+        m_free_slots.pop_back();
+        auto &s  = m_slots[index];
+        s.object = static_cast<uint32_t>(m_objects.size());
+        m_objects.emplace_back(obj, handle{index, s.generation});
+        return m_objects.back().handle;
+    }
+
+    auto z_order(vec2d_t<T> const &p) const -> uint32_t {
+        constexpr double cells = 0xffff;
+
+        auto cell = [](double v) {
+            auto c = static_cast<uint32_t>(std::clamp(v, 0.0, 1.0) * cells);
+            c      = (c | (c << 8U)) & 0x00ff00ffU;
+            c      = (c | (c << 4U)) & 0x0f0f0f0fU;
+            c      = (c | (c << 2U)) & 0x33333333U;
+            return (c | (c << 1U)) & 0x55555555U;
+        };
+        auto const &r = m_root.rect();
+        auto        x = static_cast<double>(p.x - r.position.x) / r.size.x;
+        auto        y = static_cast<double>(p.y - r.position.y) / r.size.y;
+        return cell(x) | (cell(y) << 1U);
     }
 };
+
+// Trees of dimensionless objects. They keep a point per object instead of a
+// rect and hold every object in the deepest node under it.
+template <typename T, typename Object, typename Summary = no_summary>
+using static_point_tree = static_quad_tree<T, Object, Summary, vec2d_t<T>>;
+
+template <typename T, typename Object, typename Summary = no_summary>
+using dynamic_point_tree = dynamic_quad_tree<T, Object, Summary, vec2d_t<T>>;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+enum rng_stream : uint64_t { rng_stream_boids = 1, rng_stream_stars };
+
+// Counter based generator. Draw number d of item i is a pure function of
+// (seed, stream, i, d), so items can be generated in any order, on any number
+// of threads, and always come out the same.
+class counter_rng {
+    static constexpr uint64_t golden = 0x9e3779b97f4a7c15U;
+
+    uint64_t m_key;
+
+    static constexpr auto mix(uint64_t z) -> uint64_t {
+        z = (z ^ (z >> 30U)) * 0xbf58476d1ce4e5b9U;
+        z = (z ^ (z >> 27U)) * 0x94d049bb133111ebU;
+        return z ^ (z >> 31U);
+    }
+
+  public:
+    constexpr counter_rng(uint64_t seed, rng_stream stream)
+        : m_key{mix(seed ^ mix(stream * golden))} {}
+
+    [[nodiscard]] constexpr auto bits(uint64_t i, uint64_t d) const
+        -> uint64_t {
+        return mix(mix(m_key + i * golden) + d * golden);
+    }
+
+    // In [0, 1).
+    [[nodiscard]] constexpr auto uniform(uint64_t i, uint64_t d) const
+        -> double {
+        constexpr double scale = 1.0 / static_cast<double>(1ULL << 53U);
+        return static_cast<double>(bits(i, d) >> 11U) * scale;
+    }
+
+    [[nodiscard]] constexpr auto uniform_between(uint64_t i, uint64_t d,
+                                                 double lo, double hi) const
+        -> double {
+        return lo + uniform(i, d) * (hi - lo);
+    }
+};
@@ -0,0 +1,219 @@
+#include "render.h"
+
+#include <bit>
+#include <iterator>
+
+#include <SDL.h>
+#include <fmt/format.h>
+
+#include "config.h"
+#include "constants.h"
+#include "fast_trig.h"
+
+namespace {
+
+// Draws one layer, charging its time and draw calls to stats if given. The
+// callable returns the number of draw calls it made.
+template <typename F> void draw_layer(render_stats *stats, layer l, F &&draw) {
+    if(stats == nullptr) {
+        draw();
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    stats->layers[l].draw_calls += draw();
+    if(stats->flush) {
+        stats->flush();
+    }
+    stats->layers[l].time += std::chrono::steady_clock::now() - start;
+}
+
+auto draw_stars(frame_t const &f, gfx::renderer &r) -> size_t {
+    r.set_draw_color(gfx::color_light_grey);
+    for(auto const &pt : f.stars) {
+        r.draw_point(gfx::world_to_window(pt, f.view, window_width));
+    }
+    return f.stars.size();
+}
+
+// One point per cell into the heatmap texture, shaded by the log of the count,
+// then the texture stretched over the window.
+auto draw_heatmap(frame_t const &f, assets_t &a, gfx::renderer &r) -> size_t {
+    auto shade = [](uint32_t count) -> size_t {
+        return std::min<size_t>(std::bit_width(count), heatmap_levels);
+    };
+    r.set_target(*a.heatmap);
+    r.set_draw_color(0, 0, 0, SDL_ALPHA_TRANSPARENT);
+    r.clear();
+    size_t calls = 0;
+    for(size_t level = 1; level <= heatmap_levels; ++level) {
+        r.set_draw_color(gfx::color::max_value, gfx::color::max_value / 2,
+                         gfx::color::max_value / 2,
+                         static_cast<int>(level * gfx::color::max_value /
+                                          heatmap_levels));
+        for(size_t i = 0; i < f.heatmap.size(); ++i) {
+            if(shade(f.heatmap[i]) == level) {
+                r.draw_point({static_cast<double>(i % heatmap_columns),
+                              static_cast<double>(i / heatmap_columns)});
+                ++calls;
+            }
+        }
+    }
+    r.reset_target();
+
+    // a view the size of the grid puts one cell on each 10 by 10 pixels
+    rect<double> grid{{0, 0}, {heatmap_columns, heatmap_rows}};
+    r.draw_texture(*a.heatmap, grid.size / 2, 0, grid.size / 2, grid, false);
+    return calls + 1;
+}
+
+auto draw_boids(frame_t const &f, assets_t &a, gfx::renderer &r) -> size_t {
+    if(f.boid_heatmap) {
+        return draw_heatmap(f, a, r);
+    }
+    auto &headings = a.headings;
+    headings.resize(f.boid_velocities.size());
+    fast_headings_deg(f.boid_velocities, headings);
+    for(size_t i = 0; i < f.boid_positions.size(); ++i) {
+        r.draw_texture(*a.boid.texture, f.boid_positions[i], headings[i],
+                       a.boid.texture_center, f.view,
+                       !f.keys_pressed.test(key_show_boids));
+    }
+    return f.boid_positions.size();
+}
+
+auto draw_shots(frame_t const &f, assets_t &a, gfx::renderer &r) -> size_t {
+    for(auto const &s : f.shots) {
+        r.draw_texture(*a.shot.texture, s.p_rect.position,
+                       rad_to_deg(s.heading), a.shot.texture_center, f.view,
+                       !f.keys_pressed.test(key_show_ship));
+    }
+    return f.shots.size();
+}
+
+auto draw_explosions(frame_t const &f, gfx::renderer &r) -> size_t {
+    size_t calls = 0;
+    for(auto const &expl : f.explosions) {
+        r.set_draw_color(gfx::color_red);
+        double radius = (explosion_pressure - expl.pressure_left) /
+                        explosion_pressure * explosion_visual_radius;
+        if(f.view.overlaps(rect<double>{expl.position - vec2d{radius, radius},
+                                        vec2d{radius * 2, radius * 2}})) {
+            r.draw_circle(
+                gfx::world_to_window(expl.position, f.view, window_width),
+                radius / (f.view.size.x / window_width),
+                explosion_circle_segments);
+            ++calls;
+        }
+    }
+    return calls;
+}
+
+auto draw_ship(frame_t const &f, assets_t &a, gfx::renderer &r) -> size_t {
+    auto const &sh = f.ship;
+    r.draw_texture(*a.ship.texture, sh.p_rect.position, rad_to_deg(sh.heading),
+                   a.ship.texture_center, f.view,
+                   !f.keys_pressed.test(key_show_ship));
+    if(!gfx::modifier_key_pressed(KMOD_SHIFT)) {
+        return 1;
+    }
+    r.set_draw_color(gfx::color_red.with_alpha(gfx::color::mid_value));
+    r.draw_line(gfx::world_to_window(sh.p_rect.position, f.view, window_width),
+                gfx::world_to_window(sh.p_rect.position +
+                                         vec2d::from_angle(sh.heading) *
+                                             (world_width + world_height),
+                                     f.view, window_width));
+    return 2;
+}
+
+auto draw_info(frame_t const &f, assets_t &a, gfx::renderer &r,
+               double render_time) -> size_t {
+    fmt::memory_buffer text;
+    fmt::format_to(std::back_inserter(text), "REM {}/{}", f.boids_left,
+                   number_of_boids);
+    if(f.show_fps) {
+        fmt::format_to(std::back_inserter(text),
+                       "\nFPS {:.2f}\nSIM {:.2f}\nLOD 1/{}", 1.0 / render_time,
+                       1.0 / f.frame_time, f.lod_interval);
+    }
+    if(f.show_fps && allocations_tracked()) {
+        fmt::format_to(std::back_inserter(text), "\nALLOC");
+        for(size_t p = 0; p < phase_count; ++p) {
+            fmt::format_to(std::back_inserter(text), " {} {}", phase_names[p],
+                           f.allocations[p].count);
+        }
+        fmt::format_to(std::back_inserter(text), " REN {} VIOL {}",
+                       a.render_allocations.count, f.alloc_violations);
+    }
+    text.push_back('\0');
+    gfx::color c = gfx::color_green.with_alpha(gfx::color::high_value);
+    r.draw_wrapped_text(*a.font, text.data(), info_text_location,
+                        info_text_width, c);
+    return 1;
+}
+
+// Pause message, help page and cursor.
+auto draw_overlay(frame_t const &f, assets_t &a, gfx::renderer &r,
+                  vec2d const &mouse_position) -> size_t {
+    size_t calls = 0;
+
+    if(f.paused && !f.help) {
+        if(!a.pause_text) {
+            auto font = gfx::open_font(DATA_PATH "/lcd-font/LCD14.ttf", 160);
+            gfx::color c = gfx::color_green.with_alpha(gfx::color::mid_value);
+            auto       t = r.text_to_texture<double>(*font, "PAUSED", c);
+            a.pause_text     = t;
+            a.pause_position = {(window_rect.size.x - t->size().x) / 2,
+                                (window_rect.size.y - t->size().y) / 2};
+        }
+        r.draw_texture(
+            *a.pause_text,
+            gfx::window_to_world(a.pause_position, f.view, window_width),
+            f.view, false);
+        ++calls;
+    }
+
+    if(f.help) {
+        if(!a.help_text) {
+            auto font =
+                gfx::open_font(DATA_PATH "/lcd-font/LCD14.ttf", help_font_size);
+            gfx::color c = gfx::color_green.with_alpha(gfx::color::mid_value);
+            auto       t = r.wrapped_text_to_texture<double>(
+                *font, help_text, c, help_text_width);
+            a.help_text     = t;
+            a.help_position = {(window_rect.size.x - t->size().x) / 2,
+                               (window_rect.size.y - t->size().y) / 2};
+        }
+        r.draw_texture(
+            *a.help_text,
+            gfx::window_to_world(a.help_position, f.view, window_width),
+            f.view, false);
+        ++calls;
+    }
+
+    auto const &m = mouse_position;
+
+    const vec2d cursor_offset_1 = {5, 5};
+    const vec2d cursor_offset_2 = {-5, 5};
+    r.set_draw_color(gfx::color_white);
+    r.draw_line(m + cursor_offset_1, m - cursor_offset_1);
+    r.draw_line(m + cursor_offset_2, m - cursor_offset_2);
+    return calls + 2;
+}
+
+} // namespace
+
+void render(frame_t const &f, assets_t &a, gfx::renderer &r,
+            vec2d const &mouse_position, double render_time,
+            render_stats *stats) {
+    r.clear();
+    draw_layer(stats, layer_stars, [&] { return draw_stars(f, r); });
+    draw_layer(stats, layer_boids, [&] { return draw_boids(f, a, r); });
+    draw_layer(stats, layer_shots, [&] { return draw_shots(f, a, r); });
+    draw_layer(stats, layer_explosions,
+               [&] { return draw_explosions(f, r); });
+    draw_layer(stats, layer_ship, [&] { return draw_ship(f, a, r); });
+    draw_layer(stats, layer_info,
+               [&] { return draw_info(f, a, r, render_time); });
+    draw_layer(stats, layer_overlay,
+               [&] { return draw_overlay(f, a, r, mouse_position); });
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <functional>
+
+#include <gfx/gfx.h>
+
+#include "types.h"
+
+enum layer {
+    layer_stars = 0,
+    layer_boids,
+    layer_shots,
+    layer_explosions,
+    layer_ship,
+    layer_info,
+    layer_overlay,
+    layer_count
+};
+
+constexpr std::array<char const *, layer_count> layer_names{
+    "stars", "boids", "shots", "explosions", "ship", "info", "overlay"};
+
+struct layer_stats {
+    std::chrono::nanoseconds time{};
+    size_t                   draw_calls{};
+};
+
+// Accumulates per layer costs over any number of frames. The renderer may
+// batch drawing, flush is called after each layer so that the layer which
+// queued the work is the one timed for it.
+struct render_stats {
+    std::array<layer_stats, layer_count> layers{};
+    std::function<void()>                flush;
+};
+
+// Draws one frame, without presenting it.
+void render(frame_t const &f, assets_t &a, gfx::renderer &r,
+            vec2d const &mouse_position, double render_time,
+            render_stats *stats = nullptr);
@@ -0,0 +1,181 @@
+// Offscreen render benchmark. Replays scripted camera paths through the real
+// render() with SDL's dummy video driver and software renderer, so it runs
+// on a headless machine, and reports time and draw calls per layer.
+//
+//   flox_render_bench [--frames N] [--dump DIR]
+//
+// With --dump every 60th frame of each path is saved as DIR/<path>_<n>.bmp,
+// for diffing rendering changes against a previous build.
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include <SDL.h>
+#include <fmt/format.h>
+#include <gfx/gfx.h>
+
+#include "config.h"
+#include "constants.h"
+#include "render.h"
+#include "simulation.h"
+#include "types.h"
+
+namespace {
+
+constexpr double frame_time      = 1.0 / 60;
+constexpr size_t default_frames  = 600;
+constexpr size_t dump_interval   = 60;
+constexpr double pan_per_second  = 400;
+constexpr double follow_turn_key = 3; // seconds between flips of the turn key
+
+enum camera_path { path_window = 0, path_world, path_follow, path_count };
+
+constexpr std::array<char const *, path_count> path_names{"window", "world",
+                                                          "follow"};
+
+struct options {
+    size_t      frames{default_frames};
+    std::string dump_dir;
+};
+
+// gfx keeps its SDL handles to itself, the window is the only one created.
+auto sdl_renderer() -> SDL_Renderer * {
+    return SDL_GetRenderer(SDL_GetWindowFromID(1));
+}
+
+void dump(std::string const &path) {
+    auto *r = sdl_renderer();
+    int   w = 0;
+    int   h = 0;
+    SDL_GetRendererOutputSize(r, &w, &h);
+    auto *surface =
+        SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if(surface == nullptr) {
+        return;
+    }
+    if(SDL_RenderReadPixels(r, nullptr, SDL_PIXELFORMAT_ARGB8888,
+                            surface->pixels, surface->pitch) == 0) {
+        SDL_SaveBMP(surface, path.c_str());
+    }
+    SDL_FreeSurface(surface);
+}
+
+// Moves the camera for frame n of a path, before the frame is simulated.
+void script(state &st, camera_path p, size_t n) {
+    switch(p) {
+    case path_window:
+        // window sized view sweeping across the world
+        st.view.size = window_rect.size;
+        st.view.position.x += pan_per_second * frame_time;
+        st.view.position.y += pan_per_second * frame_time / 2;
+        if(st.view.position.x + st.view.size.x > world_width) {
+            st.view.position.x = 0;
+        }
+        if(st.view.position.y + st.view.size.y > world_height) {
+            st.view.position.y = 0;
+        }
+        break;
+    case path_world:
+        st.view = world_rect;
+        break;
+    case path_follow: {
+        // the ship flies curves with the view centred on it
+        auto flip = static_cast<size_t>(follow_turn_key / frame_time);
+        st.keys_pressed.set(key_thrust);
+        st.keys_pressed.set(key_turn_left, (n / flip) % 2 == 0);
+        st.keys_pressed.set(key_turn_right, (n / flip) % 2 == 1);
+        st.view.size     = window_rect.size;
+        st.view.position = st.ship.entity.p_rect.position - st.view.size / 2;
+        st.view.clamp(world_rect);
+        break;
+    }
+    default:;
+    }
+}
+
+auto run(camera_path p, options const &opt, assets_t &assets,
+         gfx::renderer &r) -> render_stats {
+    auto const &win_s   = window_rect.size;
+    auto const &world_s = world_rect.size;
+
+    state st{world_seed,
+             {{(world_s.x - win_s.x) / 2, (world_s.y - win_s.y) / 2}, win_s}};
+    st.frame_time     = frame_time;
+    st.lod_simulation = false; // scheduled by timings, not reproducible
+    st.show_fps       = true;
+
+    frame_t      f;
+    render_stats stats;
+    stats.flush = [] { SDL_RenderFlush(sdl_renderer()); };
+    for(size_t n = 0; n < opt.frames; ++n) {
+        script(st, p, n);
+        update(st);
+        snapshot(st, f);
+        render(f, assets, r, window_rect.size / 2, frame_time, &stats);
+        if(!opt.dump_dir.empty() && n % dump_interval == 0) {
+            dump(fmt::format("{}/{}_{:05}.bmp", opt.dump_dir, path_names[p],
+                             n));
+        }
+        r.present();
+    }
+    return stats;
+}
+
+void report(camera_path p, render_stats const &stats, size_t frames) {
+    auto per_frame = static_cast<double>(frames);
+    fmt::print("{}\n", path_names[p]);
+
+    layer_stats total{};
+    for(size_t l = 0; l < layer_count; ++l) {
+        auto const &ls = stats.layers[l];
+        fmt::print("  {:<12}{:10.3f} ms{:12.1f} calls\n", layer_names[l],
+                   std::chrono::duration<double, std::milli>(ls.time).count() /
+                       per_frame,
+                   static_cast<double>(ls.draw_calls) / per_frame);
+        total.time       += ls.time;
+        total.draw_calls += ls.draw_calls;
+    }
+    fmt::print("  {:<12}{:10.3f} ms{:12.1f} calls\n", "total",
+               std::chrono::duration<double, std::milli>(total.time).count() /
+                   per_frame,
+               static_cast<double>(total.draw_calls) / per_frame);
+}
+
+auto parse(int argc, char **argv) -> options {
+    options opt;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        std::string_view arg{argv[i]};
+        if(arg == "--frames") {
+            opt.frames = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if(arg == "--dump") {
+            opt.dump_dir = argv[i + 1];
+        }
+    }
+    return opt;
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    auto opt = parse(argc, argv);
+
+    // headless unless told otherwise
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+    gfx::gfx gfx{};
+    auto     window =
+        gfx::create_window(NAME " " VERSION, window_width, window_height, true);
+    auto    &renderer = window->get_renderer();
+    assets_t assets{renderer};
+
+    fmt::print("{} frames per path, per frame averages\n", opt.frames);
+    for(size_t p = 0; p < path_count; ++p) {
+        auto path = static_cast<camera_path>(p);
+        report(path, run(path, opt, assets, renderer), opt.frames);
+    }
+    return 0;
+}
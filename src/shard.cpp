@@ -0,0 +1,183 @@
+#include "shard.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <system_error>
+#include <type_traits>
+
+#include <unistd.h>
+
+#include "constants.h"
+#include "simulation.h"
+
+namespace {
+
+// Both ends are the same build on the same machine.
+static_assert(std::is_trivially_copyable_v<entity_t>,
+              "boids are sent as raw bytes");
+
+void write_all(int fd, void const *data, size_t size) {
+    auto const *p = static_cast<char const *>(data);
+    while(size > 0) {
+        auto n = ::write(fd, p, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "shard send");
+        }
+        p    += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+void read_all(int fd, void *data, size_t size) {
+    auto *p = static_cast<char *>(data);
+    while(size > 0) {
+        auto n = ::read(fd, p, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "shard receive");
+        }
+        if(n == 0) {
+            throw std::system_error(ECONNRESET, std::generic_category(),
+                                    "shard receive");
+        }
+        p    += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+void send_boids(int fd, std::vector<entity_t> const &boids) {
+    uint64_t n = boids.size();
+    write_all(fd, &n, sizeof n);
+    write_all(fd, boids.data(), n * sizeof(entity_t));
+}
+
+void receive_boids(int fd, std::vector<entity_t> &boids) {
+    uint64_t n = 0;
+    read_all(fd, &n, sizeof n);
+    boids.resize(n);
+    read_all(fd, boids.data(), n * sizeof(entity_t));
+}
+
+// The lower shard of a pair sends first and the higher one receives first,
+// so neither can wait on a full socket buffer while the other does the same.
+void exchange(int fd, bool lower, std::vector<entity_t> const &out,
+              std::vector<entity_t> &in) {
+    in.clear();
+    if(fd == no_link) {
+        return;
+    }
+    if(lower) {
+        send_boids(fd, out);
+        receive_boids(fd, in);
+    } else {
+        receive_boids(fd, in);
+        send_boids(fd, out);
+    }
+}
+
+// Swaps batches with both neighbours, inserting what arrives and collecting
+// the new handles into added if given.
+void exchange_with_neighbours(state &st, shard_t &sh,
+                              std::vector<entity_tree::handle> *added) {
+    auto &tree = st.boids.entities;
+    auto  take = [&] {
+        for(auto const &b : sh.incoming) {
+            auto h = tree.insert(b, boid_key(b));
+            if(added != nullptr) {
+                added->push_back(h);
+            }
+        }
+    };
+    exchange(sh.left, /*lower=*/false, sh.to_left, sh.incoming);
+    take();
+    exchange(sh.right, /*lower=*/true, sh.to_right, sh.incoming);
+    take();
+}
+
+} // namespace
+
+auto max_shards() -> size_t {
+    return static_cast<size_t>(world_width / boid_cohesion_dist);
+}
+
+auto shard_strip(size_t index, size_t count) -> rect<double> {
+    double width = world_rect.size.x / static_cast<double>(count);
+    return {{width * static_cast<double>(index), 0},
+            {width, world_rect.size.y}};
+}
+
+auto shard_of(vec2d const &p, size_t count) -> size_t {
+    double width = world_rect.size.x / static_cast<double>(count);
+    double index = std::clamp(std::floor(p.x / width), 0.0,
+                              static_cast<double>(count - 1));
+    return static_cast<size_t>(index);
+}
+
+void claim_strip(state &st, shard_t &sh) {
+    st.ship.present = false;
+    auto &tree      = st.boids.entities;
+    tree.items(sh.owned);
+    for(auto h : sh.owned) {
+        if(shard_of(tree[h].p_rect.position, sh.count) != sh.index) {
+            tree.remove(h);
+        }
+    }
+}
+
+void update_shard(state &st, shard_t &sh) {
+    auto &tree  = st.boids.entities;
+    auto  strip = shard_strip(sh.index, sh.count);
+    auto  lo    = strip.position.x;
+    auto  hi    = strip.position.x + strip.size.x;
+
+    // halo, every boid a neighbour's boid could flock with
+    tree.items(sh.owned);
+    sh.to_left.clear();
+    sh.to_right.clear();
+    for(auto h : sh.owned) {
+        auto const &b = tree[h];
+        auto        x = b.p_rect.position.x;
+        if(sh.left != no_link && x - lo < boid_cohesion_dist) {
+            sh.to_left.push_back(b);
+        }
+        if(sh.right != no_link && hi - x < boid_cohesion_dist) {
+            sh.to_right.push_back(b);
+        }
+    }
+    sh.halo.clear();
+    exchange_with_neighbours(st, sh, &sh.halo);
+
+    for(auto h : sh.owned) {
+        tree[h].pending_time += st.frame_time;
+        update_boid_acceleration(st, h);
+    }
+    for(auto h : sh.halo) {
+        tree.remove(h);
+    }
+    for(auto h : sh.owned) {
+        update_boid_position(st, h);
+    }
+
+    // migration, strips are wider than a boid moves in a frame
+    sh.to_left.clear();
+    sh.to_right.clear();
+    for(auto h : sh.owned) {
+        auto const &b     = tree[h];
+        auto        owner = shard_of(b.p_rect.position, sh.count);
+        if(owner == sh.index) {
+            continue;
+        }
+        (owner < sh.index ? sh.to_left : sh.to_right).push_back(b);
+        tree.remove(h);
+    }
+    exchange_with_neighbours(st, sh, nullptr);
+}
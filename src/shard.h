@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+
+// The world split into vertical strips, each simulated by its own process.
+// A shard owns the boids in its strip and holds copies of its neighbours'
+// boids within boid_cohesion_dist of the borders, which is all the flocking
+// rules look at. Neighbours talk over a connected stream socket.
+constexpr int no_link = -1;
+
+struct shard_t {
+    size_t index{};
+    size_t count{1};
+    int    left{no_link}; // socket to shard index - 1, if there is one
+    int    right{no_link};
+
+    // reused from frame to frame
+    std::vector<entity_tree::handle> owned;
+    std::vector<entity_tree::handle> halo;
+    std::vector<entity_t>            to_left;
+    std::vector<entity_t>            to_right;
+    std::vector<entity_t>            incoming;
+};
+
+// Strips are at least boid_cohesion_dist wide, so halos only ever come from
+// direct neighbours.
+auto max_shards() -> size_t;
+
+auto shard_strip(size_t index, size_t count) -> rect<double>;
+
+auto shard_of(vec2d const &p, size_t count) -> size_t;
+
+// Drops the boids outside the shard's strip, for a state created with the
+// whole world, and the ship, which shards don't simulate.
+void claim_strip(state &st, shard_t &sh);
+
+// One frame of the shard's boids: halo exchange, the usual acceleration and
+// position updates, and migration of boids that crossed a border. Throws
+// std::system_error when a neighbour's socket fails.
+void update_shard(state &st, shard_t &sh);
@@ -0,0 +1,157 @@
+// Runs the boids of the world sharded over processes on this machine, linked
+// to their neighbours by socket pairs, and reports how they kept up.
+//
+//   flox_shards [--shards N] [--frames N]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "shard.h"
+#include "simulation.h"
+#include "types.h"
+
+namespace {
+
+constexpr double frame_time      = 1.0 / 60;
+constexpr size_t default_shards  = 4;
+constexpr size_t default_frames  = 600;
+constexpr int    shard_exit_fail = 1;
+
+struct options {
+    size_t shards{default_shards};
+    size_t frames{default_frames};
+};
+
+// What a shard process reports back through its pipe.
+struct shard_result {
+    uint64_t boids{};
+    double   seconds{};
+};
+
+auto parse(int argc, char **argv) -> options {
+    options opt;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        std::string_view arg{argv[i]};
+        auto             value = std::strtoull(argv[i + 1], nullptr, 10);
+        if(arg == "--shards") {
+            opt.shards = std::clamp<size_t>(value, 1, max_shards());
+        } else if(arg == "--frames") {
+            opt.frames = value;
+        }
+    }
+    return opt;
+}
+
+auto run_shard(shard_t &sh, size_t frames) -> shard_result {
+    state st{world_seed, window_rect};
+    st.frame_time = frame_time;
+    claim_strip(st, sh);
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t f = 0; f < frames; ++f) {
+        update_shard(st, sh);
+    }
+    return {st.boids.entities.size(),
+            std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          start)
+                .count()};
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    auto opt = parse(argc, argv);
+
+    // links[i] joins shard i to shard i + 1
+    std::vector<std::array<int, 2>> links(opt.shards - 1);
+    for(auto &l : links) {
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, l.data()) != 0) {
+            perror("socketpair");
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<int>   results(opt.shards);
+    std::vector<pid_t> children(opt.shards);
+    for(size_t i = 0; i < opt.shards; ++i) {
+        std::array<int, 2> pipe_fds{};
+        if(pipe(pipe_fds.data()) != 0) {
+            perror("pipe");
+            return EXIT_FAILURE;
+        }
+        children[i] = fork();
+        if(children[i] < 0) {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if(children[i] > 0) {
+            close(pipe_fds[1]);
+            results[i] = pipe_fds[0];
+            continue;
+        }
+
+        close(pipe_fds[0]);
+        shard_t sh;
+        sh.index = i;
+        sh.count = opt.shards;
+        for(size_t l = 0; l < links.size(); ++l) {
+            if(l + 1 == i) {
+                sh.left = links[l][1];
+            } else if(l == i) {
+                sh.right = links[l][0];
+            } else {
+                close(links[l][0]);
+                close(links[l][1]);
+            }
+        }
+        try {
+            auto r = run_shard(sh, opt.frames);
+            if(write(pipe_fds[1], &r, sizeof r) !=
+               static_cast<ssize_t>(sizeof r)) {
+                _exit(shard_exit_fail);
+            }
+        } catch(std::exception const &e) {
+            fmt::print(stderr, "shard {}: {}\n", i, e.what());
+            _exit(shard_exit_fail);
+        }
+        _exit(0);
+    }
+    for(auto const &l : links) {
+        close(l[0]);
+        close(l[1]);
+    }
+
+    fmt::print("{} shards, {} frames\n", opt.shards, opt.frames);
+    uint64_t total = 0;
+    bool     ok    = true;
+    for(size_t i = 0; i < opt.shards; ++i) {
+        shard_result r;
+        bool         reported =
+            read(results[i], &r, sizeof r) == static_cast<ssize_t>(sizeof r);
+        int status = 0;
+        waitpid(children[i], &status, 0);
+        close(results[i]);
+        if(!reported || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fmt::print("  shard {:>2}  failed\n", i);
+            ok = false;
+            continue;
+        }
+        total += r.boids;
+        fmt::print("  shard {:>2}  {:6} boids  {:8.3f} ms/frame\n", i, r.boids,
+                   r.seconds * 1000 / static_cast<double>(opt.frames));
+    }
+    fmt::print("  total     {:6} boids of {}\n", total, number_of_boids);
+    return ok && total == number_of_boids ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,854 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <optional>
+
+#include <SDL.h>
+#include <gfx/gfx.h>
+
+#include "simulation.h"
+#include "constants.h"
+#include "types.h"
+
+auto key_code(SDL_Keycode k) -> std::optional<key> {
+    switch(k) {
+    case SDLK_ESCAPE:
+    case SDLK_q:
+        return key_quit;
+    case SDLK_w:
+        return key_thrust;
+    case SDLK_s:
+        return key_reverse;
+    case SDLK_a:
+        return key_strafe_left;
+    case SDLK_d:
+        return key_strafe_right;
+    case SDLK_LEFT:
+        return key_turn_left;
+    case SDLK_RIGHT:
+        return key_turn_right;
+    case SDLK_SPACE:
+        return key_fire;
+    case SDLK_e:
+        return key_center_view;
+    case SDLK_PLUS:
+        return key_zoom_in;
+    case SDLK_MINUS:
+        return key_zoom_out;
+    case SDLK_0:
+        return key_zoom_world;
+    case SDLK_1:
+        return key_zoom_window;
+    case SDLK_UP:
+        return key_show_ship;
+    case SDLK_DOWN:
+        return key_show_boids;
+    case SDLK_f:
+        return key_show_fps;
+    case SDLK_n:
+        return key_new_boid;
+    case SDLK_p:
+        return key_pause;
+    case SDLK_h:
+        return key_help;
+    case SDLK_b:
+        return key_approximate;
+    case SDLK_l:
+        return key_lod;
+    case SDLK_t:
+        return key_topological;
+    default:
+        return std::nullopt;
+    }
+}
+
+auto edge_bounce(entity_t &entity) -> bool {
+    bool bounced = false;
+    if(entity.p_rect.position.x < 0 ||
+       entity.p_rect.position.x > world_rect.size.x) {
+        entity.velocity.x *= -1;
+        bounced           = true;
+    }
+
+    if(entity.p_rect.position.y < 0 ||
+       entity.p_rect.position.y > world_rect.size.y) {
+        entity.velocity.y *= -1;
+        bounced           = true;
+    }
+
+    if(bounced) {
+        entity.p_rect.position.x =
+            std::clamp(entity.p_rect.position.x, 0.0, world_rect.size.x);
+        entity.p_rect.position.y =
+            std::clamp(entity.p_rect.position.y, 0.0, world_rect.size.y);
+    }
+
+    return bounced;
+}
+
+auto avoid_ship(entity_t &e, entity_t &s) -> vec2d {
+    constexpr double avoid_dist    = 200;
+    constexpr double avoid_dist_sq = avoid_dist * avoid_dist;
+
+    auto &ep = e.p_rect.position;
+    auto &sp = s.p_rect.position;
+    if((ep - sp).mag_sq() < avoid_dist_sq) {
+        return (sp - ep).norm() * -1 * boid_max_accel;
+    }
+    return {0, 0};
+}
+
+auto input_acceleration(state &st) -> vec2d {
+    vec2d acceleration{};
+    auto &she = st.ship.entity;
+    auto &shp = she.p_rect;
+    auto &shh = she.heading;
+
+    acceleration += vec2d::from_angle(shh).with_mag(ship_max_accel) *
+                    static_cast<double const>(st.keys_pressed.test(key_thrust));
+
+    acceleration -=
+        vec2d::from_angle(shh + M_PI / 2).with_mag(ship_max_accel / 2) *
+        static_cast<double const>(st.keys_pressed.test(key_strafe_left));
+    acceleration -=
+        vec2d::from_angle(shh).with_mag(ship_max_accel / 2) *
+        static_cast<double const>(st.keys_pressed.test(key_reverse));
+    acceleration +=
+        vec2d::from_angle(shh + M_PI / 2).with_mag(ship_max_accel / 2) *
+        static_cast<double const>(st.keys_pressed.test(key_strafe_right));
+    she.heading -=
+        (st.shift ? ship_aim_yaw : ship_max_yaw) *
+        static_cast<double>(st.keys_pressed.test(key_turn_left)) *
+        st.frame_time;
+    she.heading +=
+        (st.shift ? ship_aim_yaw : ship_max_yaw) *
+        static_cast<double>(st.keys_pressed.test(key_turn_right)) *
+        st.frame_time;
+    she.velocity += acceleration * st.frame_time;
+    she.velocity.limit(ship_max_speed);
+
+    shp.position += she.velocity * st.frame_time;
+    if(edge_bounce(she)) {
+        she.heading = she.velocity.theta();
+    }
+    if(st.keys_pressed.test(key_fire)) {
+        auto time_from_last_shot =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                st.frame_start_time - st.last_fired)
+                .count();
+        if(time_from_last_shot >= shot_cooldown_ms) {
+            st.last_fired = st.frame_start_time;
+            st.shots.entities.emplace_back(
+                shp,
+                she.velocity + vec2d::from_angle(she.heading) * shot_base_speed,
+                she.heading);
+        }
+    }
+
+    shh = std::fmod(she.heading + 2 * M_PI, 2 * M_PI);
+
+    return acceleration;
+}
+
+constexpr auto sq(double x) -> double { return x * x; }
+
+auto outside(vec2d const &p) { return !world_rect.overlaps({p, {1, 1}}); }
+
+auto avoid_edge(entity_t &e) -> vec2d {
+    auto const &p          = e.p_rect.position;
+    auto const  future_pos = p + e.velocity * 2;
+    vec2d       accel{};
+    if(outside(future_pos)) {
+        double speed = e.velocity.mag();
+        accel        = e.velocity * -boid_max_accel;
+        // quadrant tests and quarter turns straight from the direction, so
+        // no heading is needed
+        vec2d dir = speed > 0 ? e.velocity / speed : vec2d{1, 0};
+        bool  first_left{};
+        first_left =
+            ((future_pos.x < 0 && dir.y >= 0) ||
+             (future_pos.x >= world_rect.size.x && dir.y < 0) ||
+             (future_pos.y < 0 && !(dir.y < 0 && dir.x > 0)) ||
+             (future_pos.y >= world_rect.size.y && dir.y >= 0 && dir.x >= 0));
+        vec2d left  = {dir.y, -dir.x};
+        vec2d right = {-dir.y, dir.x};
+        auto  first = first_left ? left : right;
+        if(!outside(p + first * speed * 2)) {
+            return first * boid_max_accel;
+        }
+        auto second = first_left ? right : left;
+        if(!outside(p + second * speed * 2)) {
+            return second * boid_max_accel;
+        }
+    }
+    return accel;
+}
+
+// Alignment and cohesion totals over the boids within radius of p, taking
+// every subtree that is entirely in range, or far and small enough, whole.
+auto flock_around(state &st, vec2d const &p, double radius) -> flock_summary {
+    auto node_filter = [&](rect<double> const  &r,
+                           flock_summary const &s) -> fold_action {
+        if(s.count == 0) {
+            return fold_action::skip;
+        }
+        auto const &lo = r.position;
+        auto const  hi = r.position + r.size;
+        vec2d       nearest{std::clamp(p.x, lo.x, hi.x),
+                      std::clamp(p.y, lo.y, hi.y)};
+        vec2d farthest{p.x - lo.x > hi.x - p.x ? lo.x : hi.x,
+                       p.y - lo.y > hi.y - p.y ? lo.y : hi.y};
+        auto  near_sq = (nearest - p).mag_sq();
+        if(near_sq >= sq(radius)) {
+            return fold_action::skip;
+        }
+        if((farthest - p).mag_sq() < sq(radius)) {
+            return fold_action::take;
+        }
+        if(sq(std::max(r.size.x, r.size.y)) < sq(flocking_theta) * near_sq) {
+            auto centroid = s.position_sum / static_cast<double>(s.count);
+            return (centroid - p).mag_sq() < sq(radius) ? fold_action::take
+                                                        : fold_action::skip;
+        }
+        return fold_action::descend;
+    };
+    auto object_filter = [&](vec2d const & /*pos*/, flock_summary const &s) {
+        return (s.position_sum - p).mag_sq() < sq(radius);
+    };
+    return st.boids.entities.fold(node_filter, object_filter);
+}
+
+// Adds what other, dist_sq away, does to e's flocking to t.
+void add_neighbour(flock_totals &t, entity_t const &e, entity_t const &other,
+                   double dist_sq) {
+    if(dist_sq < sq(boid_alignment_dist)) {
+        t.alignment += other.velocity;
+        ++t.alignment_num;
+    }
+    if(dist_sq < sq(boid_cohesion_dist)) {
+        t.cohesion += other.p_rect.position;
+        ++t.cohesion_num;
+    }
+    if(dist_sq < sq(e.separation)) {
+        vec2d vec    = e.p_rect.position - other.p_rect.position;
+        vec          *= std::pow(e.separation, 3) / 2 / dist_sq;
+        t.separation += vec;
+    }
+}
+
+// Task k's share of the flocking sums, when every boid is due: slices k,
+// k + flock_pair_tasks and so on of the pairs of boids in range, each pair
+// added to both of its boids.
+void pair_flocks(state &st, size_t k) {
+    auto &totals = st.scratch.flock[k];
+    if(!st.scratch.flock_paired) {
+        return;
+    }
+    totals.assign(st.boids.entities.slots(), {});
+    auto add_pair = [&](entity_tree::handle a, entity_tree::handle b,
+                        double dist_sq) {
+        auto const &ea = st.boids.entities[a];
+        auto const &eb = st.boids.entities[b];
+        add_neighbour(totals[a.index], ea, eb, dist_sq);
+        add_neighbour(totals[b.index], eb, ea, dist_sq);
+    };
+    constexpr double radius = std::max(boid_alignment_dist, boid_cohesion_dist);
+    for(size_t s = k; s < entity_tree::pair_slices; s += flock_pair_tasks) {
+        st.boids.entities.pairs(radius, add_pair, s);
+    }
+}
+
+void update_boid_acceleration(state &st, entity_tree::handle h) {
+    constexpr double alignment_dist = boid_alignment_dist;
+    constexpr double cohesion_dist  = boid_cohesion_dist;
+
+    auto &b  = st.boids.entities[h];
+    auto &bp = b.p_rect.position;
+    b.acceleration = {0, 0};
+    b.exploded     = false;
+    for(auto const &expl : st.explosions) {
+        auto dist_sq = (expl.position - bp).mag_sq();
+        dist_sq      = std::max(dist_sq, 1.0);
+        auto rad_sq  = sq(explosion_pressure_radius);
+        if(dist_sq < rad_sq) {
+            vec2d expl_accel = bp - expl.position;
+            auto  pressure   = std::min(expl.pressure_left,
+                                           explosion_pressure_per_sec *
+                                               b.pending_time);
+            expl_accel.set_mag(pressure * explosion_pressure_radius /
+                               sqrt(dist_sq));
+            b.acceleration += expl_accel;
+            b.exploded     = true;
+        }
+    }
+    if(b.exploded) {
+        return;
+    }
+
+    vec2d avoid = st.ship.present ? avoid_ship(b, st.ship.entity) : vec2d{};
+    avoid       += avoid_edge(b);
+    if(!avoid.is_zero()) {
+        b.acceleration = avoid;
+        b.acceleration.limit(boid_max_accel);
+        return;
+    }
+
+    vec2d            alignment_vec{};
+    int              alignment_num{};
+    vec2d            cohesion_vec{};
+    int              cohesion_num{};
+    vec2d            separation_vec{};
+    constexpr double max_dist = std::max(alignment_dist, cohesion_dist);
+    vec2d            nearby   = {max_dist, max_dist};
+
+    auto separate = [&](vec2d const &op, double dist_sq) {
+        if(dist_sq < sq(b.separation)) {
+            vec2d vec      = bp - op;
+            vec            *= std::pow(b.separation, 3) / 2 / dist_sq;
+            separation_vec += vec;
+        }
+    };
+
+    if(st.scratch.flock_paired) {
+        // summed for every boid at once by pair_flocks()
+        for(auto const &part : st.scratch.flock) {
+            auto const &t  = part[h.index];
+            alignment_vec  += t.alignment;
+            alignment_num  += t.alignment_num;
+            cohesion_vec   += t.cohesion;
+            cohesion_num   += t.cohesion_num;
+            separation_vec += t.separation;
+        }
+    } else if(st.topological_flocking) {
+        // a fixed number of nearest neighbours, at whatever distance
+        auto &nearest = st.scratch.nearest;
+        st.boids.entities.nearest(bp, flock_neighbours, nearest,
+                                  st.scratch.frontier,
+                                  [h](auto other) { return !(other == h); });
+        for(auto [dist_sq, other] : nearest) {
+            auto &o       = st.boids.entities[other];
+            alignment_vec += o.velocity;
+            cohesion_vec  += o.p_rect.position;
+            separate(o.p_rect.position, dist_sq);
+        }
+        alignment_num = static_cast<int>(nearest.size());
+        cohesion_num  = alignment_num;
+    } else {
+        bool approximate = st.approximate_flocking;
+        if(approximate) {
+            // one fold serves both, at the larger of the two distances
+            auto flock    = flock_around(st, bp, max_dist);
+            flock         -= flock_summary::of(b, boid_key(b));
+            alignment_vec = flock.velocity_sum;
+            alignment_num = static_cast<int>(flock.count);
+            cohesion_vec  = flock.position_sum;
+            cohesion_num  = alignment_num;
+            nearby        = {b.separation, b.separation};
+        }
+
+        auto &nearby_ents = st.scratch.neighbours;
+        st.boids.entities.items(nearby_ents, {bp - nearby, nearby * 2});
+
+        for(auto &other : nearby_ents) {
+            if(other == h) {
+                continue;
+            }
+            auto &o       = st.boids.entities[other];
+            auto &op      = o.p_rect.position;
+            auto  dist_sq = (bp - op).mag_sq();
+            if(dist_sq >= sq(cohesion_dist)) {
+                continue;
+            }
+            if(!approximate && dist_sq < sq(alignment_dist)) {
+                alignment_vec += o.velocity;
+                ++alignment_num;
+            }
+            if(!approximate && dist_sq < sq(cohesion_dist)) {
+                cohesion_vec += op;
+                ++cohesion_num;
+            }
+            separate(op, dist_sq);
+        }
+    }
+    vec2d avg_vel =
+        alignment_num == 0 ? b.velocity : alignment_vec / alignment_num;
+    vec2d avg_pos = cohesion_num == 0 ? bp : cohesion_vec / cohesion_num;
+
+    avg_vel *= boid_alignment_mult;
+    avg_vel.limit(boid_cruise_speed * b.speed_variance);
+    b.acceleration = avg_vel - b.velocity;
+    b.acceleration += (avg_pos - bp) - b.velocity;
+    b.acceleration += separation_vec;
+
+    b.acceleration.limit(boid_max_accel);
+}
+
+void decay_explosions(state &st) {
+    for(auto &expl : st.explosions) {
+        expl.pressure_left -= std::min(
+            expl.pressure_left, explosion_pressure_per_sec * st.frame_time);
+    }
+    st.explosions.erase(
+        std::remove_if(begin(st.explosions), end(st.explosions),
+                       [](auto &expl) { return expl.pressure_left <= 0.0; }),
+        end(st.explosions));
+}
+
+void update_boid_position(state &st, entity_tree::handle h) {
+    auto *bptr = st.boids.entities.get(h);
+    if(bptr == nullptr) {
+        return;
+    }
+    auto &b    = *bptr;
+    b.velocity += b.acceleration * b.pending_time;
+    if(!b.exploded) {
+        b.velocity.limit(boid_max_speed * b.speed_variance);
+    }
+    b.p_rect.position += b.velocity * b.pending_time;
+    b.pending_time    = 0;
+    edge_bounce(b);
+    st.boids.entities.move(h, boid_key(b));
+}
+
+void explode(state &st, vec2d pos) {
+    st.explosions.emplace_back(pos, explosion_pressure);
+    vec2d radius_rect{explosion_lethal_radius * 2, explosion_lethal_radius * 2};
+    auto &hits = st.scratch.hits;
+    st.boids.entities.items(hits, {pos - radius_rect / 2, radius_rect});
+    for(auto h : hits) {
+        auto &e = st.boids.entities[h];
+        if((e.p_rect.position - pos).mag_sq() < sq(explosion_lethal_radius)) {
+            st.boids.entities.remove(h);
+        }
+    }
+}
+void move_shots(state &st) {
+    for(auto &shot : st.shots.entities) {
+        shot.p_rect.position += shot.velocity * st.frame_time;
+        if(!shot.p_rect.overlaps(world_rect)) {
+            shot.invalid = true;
+        }
+    }
+}
+
+void hit_with_shots(state &st) {
+    for(auto &shot : st.shots.entities) {
+        if(shot.invalid) {
+            continue;
+        }
+        if(st.boids.entities.any(boid_reach(shot.p_rect))) {
+            shot.invalid = true;
+            explode(st, shot.p_rect.position);
+        }
+    }
+    st.shots.entities.erase(
+        std::remove_if(begin(st.shots.entities), end(st.shots.entities),
+                       [](auto &shot) { return shot.invalid; }),
+        end(st.shots.entities));
+}
+
+auto update_view(state &st) -> bool {
+    bool moved = false;
+    if(st.view.size.x > world_width) {
+        st.view = world_rect;
+        moved   = true;
+    }
+
+    auto wp = gfx::world_to_window(st.ship.entity.p_rect.position, st.view,
+                                   window_width);
+    auto v  = st.ship.entity.velocity;
+    auto const &wrs = window_rect.size;
+    if((v.x < 0 && wp.x < wrs.x / 3) || (v.x > 0 && wp.x > wrs.x * 2 / 3)) {
+        st.view.position.x += st.ship.entity.velocity.x * st.frame_time;
+        moved               = true;
+    }
+    if((v.y < 0 && wp.y < wrs.y / 3) || (v.y > 0 && wp.y > wrs.y * 2 / 3)) {
+        st.view.position.y += st.ship.entity.velocity.y * st.frame_time;
+        moved               = true;
+    }
+
+    st.view.clamp(world_rect);
+    return moved;
+}
+
+void decay_ship_speed(state &st) {
+    st.ship.entity.velocity *= 1.0 - st.frame_time;
+}
+
+// Boid handles stay valid, lists of them taken before are out of order.
+void tidy_boid_storage(state &st) {
+    if(++st.frame_count % spatial_sort_interval == 0) {
+        st.boids.entities.sort_spatially();
+    }
+}
+
+template <typename F>
+void measure(double &seconds, alloc_stats &allocations, F &&f) {
+    auto before = own_allocations();
+    auto start  = std::chrono::steady_clock::now();
+    f();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    seconds      = std::chrono::duration<double>(elapsed).count();
+    allocations  = own_allocations() - before;
+}
+
+template <typename F> void measure(state &st, phase p, F &&f) {
+    measure(st.phase_seconds[p], st.allocations[p], std::forward<F>(f));
+}
+
+// The pair tasks overlap, so their phase takes as long as the slowest.
+void add_up_pairs(state &st) {
+    auto const &seconds = st.scratch.flock_seconds;
+    st.phase_seconds[phase_boid_pairs] =
+        *std::max_element(seconds.begin(), seconds.end());
+    auto &allocations = st.allocations[phase_boid_pairs];
+    allocations       = {};
+    for(auto const &a : st.scratch.flock_allocations) {
+        allocations.count += a.count;
+        allocations.bytes += a.bytes;
+    }
+}
+
+auto seen(state const &st, rect<double> const &area, entity_t const &b)
+    -> bool {
+    auto const &p = b.p_rect.position;
+    if(area.overlaps(b.p_rect) ||
+       (st.ship.entity.p_rect.position - p).mag_sq() <
+           sq(lod_ship_distance)) {
+        return true;
+    }
+    return std::any_of(begin(st.explosions), end(st.explosions),
+                       [&p](auto const &expl) {
+                           return (expl.position - p).mag_sq() <
+                                  sq(explosion_pressure_radius);
+                       });
+}
+
+// Picks the boids to simulate this frame into scratch.due. Every boid's
+// pending time grows by the frame time, due ones catch up on all of it.
+void schedule_boids(state &st) {
+    auto &all = st.scratch.boids;
+    auto &due = st.scratch.due;
+    st.boids.entities.items(all);
+    due.clear();
+
+    size_t       interval = st.lod_simulation ? st.lod.interval : 1;
+    size_t       slot     = st.frame_count % interval;
+    vec2d        margin{lod_view_margin, lod_view_margin};
+    rect<double> area{st.view.position - margin, st.view.size + margin * 2};
+    st.lod.near    = 0;
+    st.lod.distant = 0;
+    for(size_t i = 0; i < all.size(); ++i) {
+        auto &b        = st.boids.entities[all[i]];
+        b.pending_time += st.frame_time;
+        if(!st.lod_simulation || seen(st, area, b)) {
+            ++st.lod.near;
+            due.push_back(all[i]);
+        } else {
+            ++st.lod.distant;
+            if(i % interval == slot) {
+                due.push_back(all[i]);
+            }
+        }
+    }
+    // pairing costs the same however few boids are due
+    st.scratch.flock_paired = !st.approximate_flocking &&
+                              !st.topological_flocking &&
+                              due.size() == all.size();
+}
+
+// Sets the interval for distant boids so that next frame's boid updates fit
+// in boid_update_budget, given how long this frame's took.
+void adapt_lod_interval(state &st, size_t updated, double seconds) {
+    auto &lod = st.lod;
+    if(updated == 0) {
+        return;
+    }
+    double per_boid = seconds / static_cast<double>(updated);
+    if(lod.seconds_per_boid <= 0.0) {
+        lod.seconds_per_boid = per_boid;
+    }
+    lod.seconds_per_boid +=
+        lod_cost_smoothing * (per_boid - lod.seconds_per_boid);
+
+    double affordable = boid_update_budget / lod.seconds_per_boid -
+                        static_cast<double>(lod.near);
+    if(lod.distant == 0 || affordable >= static_cast<double>(lod.distant)) {
+        lod.interval = 1;
+        return;
+    }
+    auto needed  = std::ceil(static_cast<double>(lod.distant) /
+                             std::max(affordable, 1.0));
+    lod.interval = std::min(static_cast<size_t>(needed), lod_max_interval);
+}
+
+// The phases of update() and what each has to wait for. Those that touch
+// different parts of the state overlap: shots move and the ship slows down
+// while boids are simulated, the pairs of boids in range are found in slices
+// at once, and explosions decay alongside boid positions.
+// Every phase still sees the state just as it would in the serial order.
+void add_frame_tasks(state &st) {
+    auto &g     = st.frame_tasks;
+    auto  input = g.add(
+        [&st] { measure(st, phase_input, [&] { input_acceleration(st); }); });
+    auto shots = g.add(
+        [&st] { measure(st, phase_shots, [&] { move_shots(st); }); }, {input});
+    g.add([&st] { measure(st, phase_ship, [&] { decay_ship_speed(st); }); },
+          {input});
+    auto schedule = g.add([&st] { schedule_boids(st); }, {input});
+    std::array<task_graph::task_id, flock_pair_tasks> pairs{};
+    for(size_t k = 0; k < flock_pair_tasks; ++k) {
+        pairs[k] = g.add(
+            [&st, k] {
+                measure(st.scratch.flock_seconds[k],
+                        st.scratch.flock_allocations[k],
+                        [&] { pair_flocks(st, k); });
+            },
+            {schedule});
+    }
+    auto acceleration = g.add(
+        [&st] {
+            add_up_pairs(st);
+            measure(st, phase_boid_acceleration, [&] {
+                for(auto h : st.scratch.due) {
+                    update_boid_acceleration(st, h);
+                }
+            });
+        },
+        pairs);
+    auto explosions = g.add(
+        [&st] { measure(st, phase_explosions, [&] { decay_explosions(st); }); },
+        {acceleration});
+    auto positions = g.add(
+        [&st] {
+            measure(st, phase_boid_positions, [&] {
+                for(auto h : st.scratch.due) {
+                    update_boid_position(st, h);
+                }
+            });
+            adapt_lod_interval(st, st.scratch.due.size(),
+                               st.phase_seconds[phase_boid_pairs] +
+                                   st.phase_seconds[phase_boid_acceleration] +
+                                   st.phase_seconds[phase_boid_positions]);
+        },
+        {acceleration});
+    auto hits = g.add(
+        [&st] { measure(st, phase_hits, [&] { hit_with_shots(st); }); },
+        {shots, explosions, positions});
+    g.add([&st] { measure(st, phase_tidy, [&] { tidy_boid_storage(st); }); },
+          {hits});
+}
+
+void update(state &st) {
+    if(st.frame_tasks.empty()) {
+        add_frame_tasks(st);
+    }
+    st.frame_tasks.run();
+}
+
+// Adds up the boids in each heatmap cell from the tree's node counts. A node
+// no bigger than a cell, or a leaf, goes in whole at its centroid, so this
+// takes as long however many boids there are.
+void fill_heatmap(state &st, heatmap_t &heat) {
+    heat.fill(0);
+    auto const &v = st.view;
+    vec2d       cell{v.size.x / heatmap_columns, v.size.y / heatmap_rows};
+    vec2d       leaf = world_rect.size / (1U << quad_tree_max_depth);
+    vec2d       whole{std::max(cell.x, leaf.x), std::max(cell.y, leaf.y)};
+
+    auto add = [&](vec2d const &p, size_t count) {
+        auto c = p - v.position;
+        if(c.x < 0 || c.y < 0 || c.x > v.size.x || c.y > v.size.y) {
+            return;
+        }
+        // the far edges belong to the last cells
+        auto x =
+            std::min(static_cast<size_t>(c.x / cell.x), heatmap_columns - 1);
+        auto y = std::min(static_cast<size_t>(c.y / cell.y), heatmap_rows - 1);
+        heat[y * heatmap_columns + x] += static_cast<uint32_t>(count);
+    };
+    auto node_filter = [&](rect<double> const  &r,
+                           flock_summary const &s) -> fold_action {
+        if(s.count == 0 || !v.overlaps(r)) {
+            return fold_action::skip;
+        }
+        if(r.size.x <= whole.x && r.size.y <= whole.y) {
+            add(s.position_sum / static_cast<double>(s.count), s.count);
+            return fold_action::skip;
+        }
+        return fold_action::descend;
+    };
+    auto object_filter = [&](vec2d const &p, flock_summary const & /*s*/) {
+        add(p, 1);
+        return false;
+    };
+    st.boids.entities.fold(node_filter, object_filter);
+}
+
+void copy_frame(state &st, frame_t &f) {
+    f.view = st.view;
+    st.stars.items(f.stars, st.view);
+    f.boid_positions.clear();
+    f.boid_velocities.clear();
+    f.boid_heatmap = st.view.size.x / window_width >= heatmap_zoom;
+    if(f.boid_heatmap) {
+        fill_heatmap(st, f.heatmap);
+    } else {
+        st.boids.entities.items(st.scratch.visible, boid_reach(st.view));
+        for(auto h : st.scratch.visible) {
+            auto &b = st.boids.entities[h];
+            f.boid_positions.push_back(b.p_rect.position);
+            f.boid_velocities.push_back(b.velocity);
+        }
+    }
+    f.shots        = st.shots.entities;
+    f.explosions   = st.explosions;
+    f.ship         = st.ship.entity;
+    f.boids_left   = st.boids.entities.size();
+    f.frame_time   = st.frame_time;
+    f.lod_interval = st.lod_simulation ? st.lod.interval : 1;
+    f.keys_pressed = st.keys_pressed;
+    f.show_fps     = st.show_fps;
+    f.paused       = st.paused;
+    f.idle         = st.idle;
+    f.help         = st.help;
+}
+
+void snapshot(state &st, frame_t &f) {
+    measure(st, phase_snapshot, [&] { copy_frame(st, f); });
+    f.allocations      = st.allocations;
+    f.alloc_violations = thread_alloc_violations();
+}
+
+void zoom_to(rect<double> &view, vec2d new_size, vec2d new_center = {-1, -1}) {
+    vec2d w{window_rect.size};
+    if(world_rect.contains({new_center, vec2d{0, 0}})) {
+        view = {new_center - new_size / 2, new_size};
+    } else {
+        view = {gfx::window_to_world(w / 2, view, window_width) - new_size / 2,
+                new_size};
+    }
+}
+
+void handle_mouse_button_event(state &st, SDL_MouseButtonEvent const &e) {
+    switch(e.button) {
+    case SDL_BUTTON_LEFT:
+        explode(st, gfx::window_to_world(static_cast<vec2d>(st.mouse_position),
+                                         st.view, window_width));
+        break;
+    case SDL_BUTTON_RIGHT:
+        zoom_to(st.view, window_rect.size,
+                gfx::window_to_world(static_cast<vec2d>(st.mouse_position),
+                                     st.view, window_width));
+        break;
+    default:;
+    }
+}
+
+void handle_keyboard_event(state &st, SDL_KeyboardEvent const &e) {
+    auto k = key_code(e.keysym.sym);
+    if(k) {
+        st.keys_pressed.set(*k, e.state == SDL_PRESSED);
+        if(e.state == SDL_RELEASED) {
+            switch(*k) {
+            case key_show_fps:
+                st.show_fps = !st.show_fps;
+                break;
+            case key_zoom_window:
+                zoom_to(st.view, window_rect.size,
+                        st.view.position + st.view.size / 2);
+                break;
+            case key_zoom_world:
+                zoom_to(st.view, world_rect.size, st.view.position);
+                break;
+            case key_pause:
+                st.paused = !st.paused;
+                break;
+            case key_help:
+                st.help = !st.help;
+                break;
+            case key_approximate:
+                st.approximate_flocking = !st.approximate_flocking;
+                break;
+            case key_lod:
+                st.lod_simulation = !st.lod_simulation;
+                break;
+            case key_topological:
+                st.topological_flocking = !st.topological_flocking;
+                break;
+            case key_quit:
+                st.quit = true;
+                break;
+            default:;
+            }
+        }
+    }
+}
+
+void handle_input(state &st, input_t const &in) {
+    st.mouse_position = in.mouse_position;
+    st.mouse_buttons  = in.mouse_buttons;
+    st.shift          = in.shift;
+    if(!in.event) {
+        return;
+    }
+    auto const &e = *in.event;
+    switch(e.type) {
+    case SDL_QUIT:
+        st.quit = true;
+        break;
+    case SDL_MOUSEBUTTONDOWN:
+        handle_mouse_button_event(st, e.button);
+        break;
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        handle_keyboard_event(st, e.key);
+        break;
+    case SDL_WINDOWEVENT:
+        if(e.window.event == SDL_WINDOWEVENT_MINIMIZED) {
+            st.minimized = true;
+        } else if(e.window.event == SDL_WINDOWEVENT_RESTORED) {
+            st.minimized = false;
+        }
+        break;
+    default:;
+    }
+}
+
+void step(state &st) {
+    if(st.keys_pressed.test(key_center_view)) {
+        st.view.position = st.ship.entity.p_rect.position -
+                           vec2d{st.view.size.x / 2, st.view.size.y / 2};
+        st.view.clamp(world_rect);
+    }
+
+    st.frame_time =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      st.frame_start_time)
+            .count();
+    st.frame_start_time = std::chrono::steady_clock::now();
+
+    if(st.keys_pressed.test(key_new_boid)) {
+        auto b = random_boid(st.boid_rng, number_of_boids + st.boids_spawned++);
+        b.p_rect.position = world_rect.size / 2;
+        st.boids.entities.insert(b, boid_key(b));
+    }
+
+    if(st.keys_pressed.test(key_zoom_in)) {
+        zoom_to(st.view, st.view.size / (1 + zoom_per_second * st.frame_time));
+    }
+    if(st.keys_pressed.test(key_zoom_out)) {
+        zoom_to(st.view, st.view.size * (1 + zoom_per_second * st.frame_time));
+    }
+
+    // held keys still act while paused
+    bool still = st.paused || st.minimized;
+    if(!still) {
+        update(st);
+    }
+    for(auto k : {key_center_view, key_new_boid, key_zoom_in, key_zoom_out}) {
+        still = still && !st.keys_pressed.test(k);
+    }
+
+    st.idle = !update_view(st) && still;
+}
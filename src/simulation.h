@@ -0,0 +1,23 @@
+#pragma once
+
+#include "types.h"
+
+void explode(state &st, vec2d pos);
+
+void update_boid_acceleration(state &st, entity_tree::handle h);
+
+void update_boid_position(state &st, entity_tree::handle h);
+
+void update(state &st);
+
+// Follows the ship with the view, true if the view moved.
+auto update_view(state &st) -> bool;
+
+void handle_input(state &st, input_t const &in);
+
+// One simulated frame: input driven actions, update() unless paused or
+// minimized, and the view following the ship. Sets st.idle when the frame is
+// the same as the last, so nothing changes until there is input.
+void step(state &st);
+
+void snapshot(state &st, frame_t &f);
@@ -0,0 +1,62 @@
+#include "star_field.h"
+
+#include <cmath>
+
+#include "quad_tree.h"
+
+star_field::star_field(uint64_t seed)
+    : m_rng{seed, rng_stream_stars}, m_tiles(star_tile_cache) {}
+
+void star_field::generate(tile &t, int64_t x, int64_t y) const {
+    // both coordinates, 32 bits each, make the tile's item number
+    auto i  = (static_cast<uint64_t>(x) << 32U) | static_cast<uint32_t>(y);
+    t.x     = x;
+    t.y     = y;
+    t.count = m_rng.bits(i, 0) % (max_stars_per_tile + 1);
+    vec2d_t<double> corner{static_cast<double>(x) * star_tile_size,
+                           static_cast<double>(y) * star_tile_size};
+    for(size_t s = 0; s < t.count; ++s) {
+        t.stars[s] = {
+            corner.x + m_rng.uniform_between(i, 2 * s + 1, 0, star_tile_size),
+            corner.y + m_rng.uniform_between(i, 2 * s + 2, 0, star_tile_size)};
+    }
+}
+
+// A kept tile if there is one, else the one seen longest ago is made over.
+// When every kept tile is already in this query, the tile isn't kept.
+auto star_field::find(int64_t x, int64_t y) -> tile const & {
+    tile *oldest = &m_tiles.front();
+    for(auto &t : m_tiles) {
+        if(t.last_seen != 0 && t.x == x && t.y == y) {
+            t.last_seen = m_queries;
+            return t;
+        }
+        if(t.last_seen < oldest->last_seen) {
+            oldest = &t;
+        }
+    }
+    tile &t = oldest->last_seen == m_queries ? m_uncached : *oldest;
+    generate(t, x, y);
+    t.last_seen = m_queries;
+    return t;
+}
+
+void star_field::items(std::vector<vec2d_t<double>> &out,
+                       rect<double> const &area) {
+    out.clear();
+    ++m_queries;
+    auto lo = area.position / star_tile_size;
+    auto hi = (area.position + area.size) / star_tile_size;
+    for(auto y = static_cast<int64_t>(std::floor(lo.y));
+        y <= static_cast<int64_t>(std::floor(hi.y)); ++y) {
+        for(auto x = static_cast<int64_t>(std::floor(lo.x));
+            x <= static_cast<int64_t>(std::floor(hi.x)); ++x) {
+            auto const &t = find(x, y);
+            for(size_t s = 0; s < t.count; ++s) {
+                if(shape_hit(area, t.stars[s])) {
+                    out.push_back(t.stars[s]);
+                }
+            }
+        }
+    }
+}
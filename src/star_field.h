@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "random.h"
+#include "rect.h"
+#include "vec2d.h"
+
+// The background stars, made on demand for the square tiles in view. A
+// tile's stars are a pure function of the seed and the tile, so they come
+// out the same every time it is seen and nothing about the world's size is
+// kept. The last star_tile_cache tiles seen are kept.
+constexpr double star_tile_size     = 1024;
+constexpr size_t stars_per_tile     = 12; // on average
+constexpr size_t max_stars_per_tile = 2 * stars_per_tile;
+constexpr size_t star_tile_cache    = 128;
+
+class star_field {
+    struct tile {
+        int64_t                                         x{};
+        int64_t                                         y{};
+        uint64_t                                        last_seen{};
+        size_t                                          count{};
+        std::array<vec2d_t<double>, max_stars_per_tile> stars{};
+    };
+
+    counter_rng       m_rng;
+    std::vector<tile> m_tiles;
+    tile              m_uncached;
+    uint64_t          m_queries{};
+
+    void generate(tile &t, int64_t x, int64_t y) const;
+    auto find(int64_t x, int64_t y) -> tile const &;
+
+  public:
+    explicit star_field(uint64_t seed);
+
+    // Replaces out with the stars in area.
+    void items(std::vector<vec2d_t<double>> &out, rect<double> const &area);
+};
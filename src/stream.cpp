@@ -0,0 +1,294 @@
+#include "stream.h"
+
+#include <cmath>
+
+#include "constants.h"
+
+namespace {
+
+// Far more slots than any simulation uses, so a corrupt slot number can't
+// make the decoder allocate without bound.
+constexpr uint64_t max_stream_slots = uint64_t{1} << 26U;
+
+constexpr double turn = 2 * M_PI;
+
+void put_varint(std::vector<uint8_t> &out, uint64_t v) {
+    while(v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7U;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+void put_zigzag(std::vector<uint8_t> &out, int64_t v) {
+    put_varint(out, (static_cast<uint64_t>(v) << 1U) ^
+                        static_cast<uint64_t>(v >> 63));
+}
+
+void put_bytes(std::vector<uint8_t> &out, uint64_t v, size_t n) {
+    for(size_t i = 0; i < n; ++i) {
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+auto quantize(double v) -> int64_t {
+    return std::llround(v * stream_position_scale);
+}
+
+auto unquantize(int64_t v) -> double {
+    return static_cast<double>(v) / stream_position_scale;
+}
+
+auto quantize_heading(double radians) -> uint8_t {
+    return static_cast<uint8_t>(
+        static_cast<uint64_t>(std::llround(radians / turn * 256)));
+}
+
+auto unquantize_heading(uint8_t h) -> double { return h * turn / 256; }
+
+void put_point(std::vector<uint8_t> &out, vec2d const &p) {
+    put_zigzag(out, quantize(p.x));
+    put_zigzag(out, quantize(p.y));
+}
+
+// Reads what the put_ functions wrote, turning ok off instead of reading
+// past the end.
+struct reader {
+    std::span<uint8_t const> bytes;
+    size_t                   pos{};
+    bool                     ok{true};
+
+    auto byte() -> uint8_t {
+        if(pos >= bytes.size()) {
+            ok = false;
+            return 0;
+        }
+        return bytes[pos++];
+    }
+
+    auto varint() -> uint64_t {
+        uint64_t v = 0;
+        for(unsigned shift = 0; shift < 64 && ok; shift += 7) {
+            auto b = byte();
+            v      |= static_cast<uint64_t>(b & 0x7fU) << shift;
+            if((b & 0x80U) == 0) {
+                return v;
+            }
+        }
+        ok = false;
+        return v;
+    }
+
+    auto zigzag() -> int64_t {
+        auto u = varint();
+        return static_cast<int64_t>(u >> 1U) ^ -static_cast<int64_t>(u & 1U);
+    }
+
+    auto bytes_le(size_t n) -> uint64_t {
+        uint64_t v = 0;
+        for(size_t i = 0; i < n; ++i) {
+            v |= static_cast<uint64_t>(byte()) << (8 * i);
+        }
+        return v;
+    }
+
+    auto point() -> vec2d {
+        auto x = unquantize(zigzag());
+        return {x, unquantize(zigzag())};
+    }
+
+    // A count of items at least min_size bytes each, that could fit in
+    // what is left.
+    auto count(size_t min_size) -> uint64_t {
+        auto n = varint();
+        if(n > (bytes.size() - std::min(pos, bytes.size())) / min_size) {
+            ok = false;
+            return 0;
+        }
+        return n;
+    }
+};
+
+} // namespace
+
+void stream_encoder::encode(state &st, std::vector<uint8_t> &out) {
+    auto &tree = st.boids.entities;
+    tree.items(m_handles);
+    m_now.assign(m_boids.size(), std::nullopt);
+    for(auto h : m_handles) {
+        if(h.index >= m_now.size()) {
+            m_now.resize(h.index + 1);
+        }
+        m_now[h.index] = h;
+    }
+    m_boids.resize(m_now.size());
+
+    m_removed.clear();
+    m_moved.clear();
+    m_added.clear();
+    uint64_t removed      = 0;
+    uint64_t added        = 0;
+    size_t   last_removed = 0;
+    size_t   last_added   = 0;
+    for(size_t i = 0; i < m_boids.size(); ++i) {
+        auto       &b   = m_boids[i];
+        auto const &now = m_now[i];
+        if(b.live && (!now || now->generation != b.generation)) {
+            put_varint(m_removed, i - last_removed);
+            last_removed = i;
+            ++removed;
+            b.live = false;
+        }
+        if(!now) {
+            continue;
+        }
+        auto const &e       = tree[*now];
+        auto        x       = quantize(e.p_rect.position.x);
+        auto        y       = quantize(e.p_rect.position.y);
+        auto        heading = quantize_heading(e.velocity.theta());
+        if(b.live) {
+            put_zigzag(m_moved, x - b.x);
+            put_zigzag(m_moved, y - b.y);
+            m_moved.push_back(static_cast<uint8_t>(heading - b.heading));
+        } else {
+            put_varint(m_added, i - last_added);
+            last_added = i;
+            ++added;
+            put_zigzag(m_added, x);
+            put_zigzag(m_added, y);
+            m_added.push_back(heading);
+            b.live       = true;
+            b.generation = now->generation;
+        }
+        b.x       = x;
+        b.y       = y;
+        b.heading = heading;
+    }
+
+    auto &p = m_payload;
+    p.clear();
+    put_varint(p, st.frame_count);
+    put_varint(p, static_cast<uint64_t>(std::llround(st.frame_time * 1e6)));
+    put_point(p, st.view.position);
+    put_point(p, st.view.size);
+    put_point(p, st.ship.entity.p_rect.position);
+    p.push_back(quantize_heading(st.ship.entity.heading));
+    put_varint(p, removed);
+    p.insert(p.end(), m_removed.begin(), m_removed.end());
+    p.insert(p.end(), m_moved.begin(), m_moved.end());
+    put_varint(p, added);
+    p.insert(p.end(), m_added.begin(), m_added.end());
+    put_varint(p, st.shots.entities.size());
+    for(auto const &s : st.shots.entities) {
+        put_point(p, s.p_rect.position);
+        p.push_back(quantize_heading(s.heading));
+    }
+    put_varint(p, st.explosions.size());
+    for(auto const &expl : st.explosions) {
+        put_point(p, expl.position);
+        p.push_back(static_cast<uint8_t>(
+            std::lround(expl.pressure_left / explosion_pressure * 255)));
+    }
+
+    put_varint(out, p.size());
+    out.insert(out.end(), p.begin(), p.end());
+}
+
+auto stream_decoder::decode(std::span<uint8_t const> payload, frame_t &f,
+                            bool whole_world) -> bool {
+    reader r{payload};
+    r.varint(); // frame number
+    f.frame_time       = static_cast<double>(r.varint()) / 1e6;
+    auto view_position = r.point();
+    auto view_size     = r.point();
+
+    f.view = whole_world ? world_rect : rect<double>{view_position, view_size};
+
+    f.ship.p_rect   = {r.point(), ship_rect.size};
+    f.ship.heading  = unquantize_heading(r.byte());
+    f.ship.velocity = {};
+
+    size_t index = 0;
+    for(auto n = r.count(1); n > 0 && r.ok; --n) {
+        index += r.varint();
+        if(index >= m_boids.size() || !m_boids[index].live) {
+            return false;
+        }
+        m_boids[index].live = false;
+    }
+    for(auto &b : m_boids) {
+        if(b.live && r.ok) {
+            b.x       += r.zigzag();
+            b.y       += r.zigzag();
+            b.heading = static_cast<uint8_t>(b.heading + r.byte());
+        }
+    }
+    index = 0;
+    for(auto n = r.count(4); n > 0 && r.ok; --n) {
+        index += r.varint();
+        if(index >= max_stream_slots) {
+            return false;
+        }
+        if(index >= m_boids.size()) {
+            m_boids.resize(index + 1);
+        }
+        auto &b = m_boids[index];
+        if(b.live) {
+            return false;
+        }
+        b.live    = true;
+        b.x       = r.zigzag();
+        b.y       = r.zigzag();
+        b.heading = r.byte();
+    }
+
+    f.shots.clear();
+    for(auto n = r.count(3); n > 0 && r.ok; --n) {
+        auto p       = r.point();
+        auto heading = unquantize_heading(r.byte());
+        f.shots.emplace_back(rect<double>{p, shot_rect.size}, vec2d{},
+                             heading);
+    }
+    f.explosions.clear();
+    for(auto n = r.count(3); n > 0 && r.ok; --n) {
+        auto p = r.point();
+        f.explosions.emplace_back(p, r.byte() * explosion_pressure / 255);
+    }
+    if(!r.ok || r.pos != payload.size()) {
+        return false;
+    }
+
+    f.boid_positions.clear();
+    f.boid_velocities.clear();
+    f.boids_left = 0;
+    auto reach   = boid_reach(f.view);
+    for(auto const &b : m_boids) {
+        if(!b.live) {
+            continue;
+        }
+        ++f.boids_left;
+        vec2d p{unquantize(b.x), unquantize(b.y)};
+        if(whole_world || shape_hit(reach, p)) {
+            f.boid_positions.push_back(p);
+            f.boid_velocities.push_back(
+                vec2d::from_angle(unquantize_heading(b.heading)));
+        }
+    }
+    return true;
+}
+
+auto encode_header(stream_header const &h) -> std::vector<uint8_t> {
+    std::vector<uint8_t> out;
+    put_bytes(out, h.magic, 4);
+    put_bytes(out, h.version, 4);
+    put_bytes(out, h.seed, 8);
+    return out;
+}
+
+auto decode_header(std::span<uint8_t const> bytes, stream_header &h) -> bool {
+    reader r{bytes};
+    h.magic   = static_cast<uint32_t>(r.bytes_le(4));
+    h.version = static_cast<uint32_t>(r.bytes_le(4));
+    h.seed    = r.bytes_le(8);
+    return r.ok && h.magic == stream_magic && h.version == stream_version;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "types.h"
+
+// The simulated frames as a byte stream, for watching a simulation that
+// renders nothing itself. A stream header is followed by frames, each a
+// varint payload size and the payload. Positions are quantized to
+// 1/stream_position_scale of a pixel and headings to 1/256 of a turn. Boids
+// are sent as changes against the previous frame: those gone, small moves of
+// the rest in slot order, and those new. Shots and explosions are few and
+// sent whole. Bump stream_version when the layout changes.
+constexpr uint32_t stream_magic          = 0x53584c46; // "FLXS"
+constexpr uint32_t stream_version        = 1;
+constexpr double   stream_position_scale = 4;
+constexpr size_t   stream_header_size    = 16;
+
+struct stream_header {
+    uint32_t magic{stream_magic};
+    uint32_t version{stream_version};
+    uint64_t seed{};
+};
+
+// One boid as last sent, by handle slot.
+struct stream_boid {
+    uint32_t generation{};
+    bool     live{false};
+    int64_t  x{};
+    int64_t  y{};
+    uint8_t  heading{};
+};
+
+class stream_encoder {
+    std::vector<stream_boid>                        m_boids;
+    std::vector<entity_tree::handle>                m_handles;
+    std::vector<std::optional<entity_tree::handle>> m_now; // by slot
+    std::vector<uint8_t>                            m_removed;
+    std::vector<uint8_t>                            m_moved;
+    std::vector<uint8_t>                            m_added;
+    std::vector<uint8_t>                            m_payload;
+
+  public:
+    // Appends st's frame to out, size first, as changes against the last
+    // frame encoded.
+    void encode(state &st, std::vector<uint8_t> &out);
+
+    // The next frame is encoded whole, for a new reader.
+    void reset() { m_boids.clear(); }
+};
+
+class stream_decoder {
+    std::vector<stream_boid> m_boids;
+
+  public:
+    // Applies one frame's payload and fills in f, with only the boids that
+    // can be seen in its view. With whole_world the view is the world and
+    // every boid is given. False for a malformed payload, after which the
+    // decoder is out of step.
+    auto decode(std::span<uint8_t const> payload, frame_t &f,
+                bool whole_world = false) -> bool;
+};
+
+auto encode_header(stream_header const &h) -> std::vector<uint8_t>;
+
+// False unless the bytes are a header of this stream version.
+auto decode_header(std::span<uint8_t const> bytes, stream_header &h) -> bool;
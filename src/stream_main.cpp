@@ -0,0 +1,164 @@
+// Runs the simulation without rendering and streams its frames to a viewer,
+// on standard output or to each viewer connecting to a Unix socket in turn.
+//
+//   flox_stream [--socket PATH] [--boids N] [--frames N] | flox_viewer
+//
+// --boids adds boids up to N, --frames stops after N frames. A summary of
+// the bytes sent goes to standard error.
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "simulation.h"
+#include "stream.h"
+#include "types.h"
+
+namespace {
+
+struct options {
+    char const *socket_path{};
+    size_t      boids{number_of_boids};
+    size_t      frames{};
+};
+
+auto parse(int argc, char **argv) -> options {
+    options opt;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        std::string_view arg{argv[i]};
+        if(arg == "--socket") {
+            opt.socket_path = argv[i + 1];
+        } else if(arg == "--boids") {
+            opt.boids = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if(arg == "--frames") {
+            opt.frames = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    return opt;
+}
+
+// False once the reader has gone.
+auto write_all(int fd, std::vector<uint8_t> const &bytes) -> bool {
+    auto const *p    = bytes.data();
+    size_t      size = bytes.size();
+    while(size > 0) {
+        auto n = ::write(fd, p, size);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0) {
+            return false;
+        }
+        p    += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+auto listen_on(char const *path) -> int {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if(std::string_view{path}.size() >= sizeof addr.sun_path) {
+        fmt::print(stderr, "socket path too long: {}\n", path);
+        return -1;
+    }
+    std::snprintf(addr.sun_path, sizeof addr.sun_path, "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0 ||
+       listen(fd, 1) != 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void add_boids(state &st, size_t total) {
+    while(st.boids.entities.size() < total) {
+        auto b = random_boid(st.boid_rng, number_of_boids + st.boids_spawned++);
+        st.boids.entities.insert(b, boid_key(b));
+    }
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    auto opt = parse(argc, argv);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listener = -1;
+    if(opt.socket_path != nullptr) {
+        listener = listen_on(opt.socket_path);
+        if(listener < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    state st{world_seed, window_rect};
+    add_boids(st, opt.boids);
+    auto header = encode_header({stream_magic, stream_version, world_seed});
+
+    stream_encoder       encoder;
+    std::vector<uint8_t> bytes;
+    uint64_t             sent_bytes  = 0;
+    uint64_t             sent_boids  = 0;
+    size_t               frame       = 0;
+    bool                 more_frames = true;
+    st.frame_start_time              = std::chrono::steady_clock::now();
+    while(more_frames) {
+        int out = STDOUT_FILENO;
+        if(listener >= 0) {
+            out = accept(listener, nullptr, nullptr);
+            if(out < 0) {
+                perror("accept");
+                return EXIT_FAILURE;
+            }
+        }
+        encoder.reset();
+        bool connected = write_all(out, header);
+        while(connected && !st.quit) {
+            step(st);
+            bytes.clear();
+            encoder.encode(st, bytes);
+            connected  = write_all(out, bytes);
+            sent_bytes += bytes.size();
+            sent_boids += st.boids.entities.size();
+            if(++frame == opt.frames) {
+                more_frames = false;
+                break;
+            }
+        }
+        if(listener < 0) {
+            break;
+        }
+        close(out);
+    }
+
+    if(listener >= 0) {
+        close(listener);
+        unlink(opt.socket_path);
+    }
+    if(sent_boids > 0) {
+        auto bytes_sent = static_cast<double>(sent_bytes);
+        fmt::print(stderr,
+                   "{} frames, {:.1f} bytes per frame, {:.2f} per boid\n",
+                   frame, bytes_sent / static_cast<double>(frame),
+                   bytes_sent / static_cast<double>(sent_boids));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "alloc_tracker.h"
+
+// A fixed set of tasks and the order between them, run as often as needed
+// over a pool of worker threads. A task becomes ready when the last task it
+// comes after finishes, so independent tasks overlap and no thread ever waits
+// inside one. Adding tasks allocates, running them doesn't. Allocations in
+// tasks count as the calling thread's, wherever the tasks run.
+class task_graph {
+  public:
+    using task_id = size_t;
+
+  private:
+    struct task {
+        std::function<void()> run;
+        std::vector<task_id>  dependents;
+        size_t                after{};
+        size_t                waiting{};
+    };
+
+    std::vector<task>        m_tasks;
+    std::vector<task_id>     m_ready;
+    size_t                   m_unfinished{};
+    bool                     m_stop{false};
+    alloc_account           *m_caller{};
+    size_t                   m_threads;
+    std::vector<std::thread> m_workers;
+    std::mutex               m_mutex;
+    std::condition_variable  m_changed;
+
+    // Runs the latest ready task and readies those it was the last wait of.
+    void run_one(std::unique_lock<std::mutex> &lock) {
+        auto id = m_ready.back();
+        m_ready.pop_back();
+        lock.unlock();
+        {
+            alloc_proxy proxy{*m_caller};
+            m_tasks[id].run();
+        }
+        lock.lock();
+        for(auto d : m_tasks[id].dependents) {
+            if(--m_tasks[d].waiting == 0) {
+                m_ready.push_back(d);
+            }
+        }
+        --m_unfinished;
+        m_changed.notify_all();
+    }
+
+    void work() {
+        std::unique_lock lock{m_mutex};
+        while(true) {
+            m_changed.wait(lock, [this] { return m_stop || !m_ready.empty(); });
+            if(m_stop) {
+                return;
+            }
+            run_one(lock);
+        }
+    }
+
+  public:
+    // At most threads run tasks at once, the one calling run() included.
+    explicit task_graph(size_t threads = std::thread::hardware_concurrency())
+        : m_threads(std::max<size_t>(threads, 1)) {}
+    task_graph(task_graph const &)                     = delete;
+    auto operator=(task_graph const &) -> task_graph & = delete;
+
+    ~task_graph() {
+        {
+            std::lock_guard lock{m_mutex};
+            m_stop = true;
+        }
+        m_changed.notify_all();
+        for(auto &w : m_workers) {
+            w.join();
+        }
+    }
+
+    // f runs once per run(), after every task in after has finished.
+    auto add(std::function<void()> f, std::initializer_list<task_id> after = {})
+        -> task_id {
+        return add(std::move(f), std::span{after.begin(), after.size()});
+    }
+
+    auto add(std::function<void()> f, std::span<task_id const> after)
+        -> task_id {
+        std::lock_guard lock{m_mutex};
+        auto            id = m_tasks.size();
+        m_tasks.push_back({std::move(f), {}, after.size(), 0});
+        for(auto a : after) {
+            m_tasks[a].dependents.push_back(id);
+        }
+        m_ready.reserve(m_tasks.size());
+        return id;
+    }
+
+    [[nodiscard]] auto empty() const -> bool { return m_tasks.empty(); }
+
+    // Runs every task once, returning when all have finished. The calling
+    // thread works through ready tasks too, workers start on the first run.
+    void run() {
+        if(m_tasks.empty()) {
+            return;
+        }
+        std::unique_lock lock{m_mutex};
+        auto workers = std::min(m_threads, m_tasks.size()) - 1;
+        while(m_workers.size() < workers) {
+            m_workers.emplace_back([this] { work(); });
+        }
+        for(task_id id = 0; id < m_tasks.size(); ++id) {
+            m_tasks[id].waiting = m_tasks[id].after;
+            if(m_tasks[id].after == 0) {
+                m_ready.push_back(id);
+            }
+        }
+        m_unfinished = m_tasks.size();
+        m_caller     = &thread_alloc_account();
+        m_changed.notify_all();
+        while(m_unfinished != 0) {
+            if(m_ready.empty()) {
+                m_changed.wait(lock, [this] {
+                    return m_unfinished == 0 || !m_ready.empty();
+                });
+                continue;
+            }
+            run_one(lock);
+        }
+    }
+};
@@ -1,5 +1,7 @@
 #include "types.h"
+#include "config.h"
 #include "constants.h"
+#include "parallel.h"
 
 auto create_ship_texture(gfx::renderer &r) -> std::shared_ptr<gfx::texture> {
     auto texture =
@@ -46,52 +48,63 @@ auto create_shot_texture(gfx::renderer &r) -> std::shared_ptr<gfx::texture> {
 }
 
 auto create_ship(
-    gfx::renderer &r,
-    rect<double>   p = {{world_rect.size / 2},
-                        {static_cast<vec2d const>(ship_texture_size)}},
+    rect<double> p = {{world_rect.size / 2},
+                      {static_cast<vec2d const>(ship_texture_size)}},
     vec2d v = {0.0, 0.0}, double h = 0.0) -> ship_t {
-    return ship_t{{p, v, h}, create_ship_texture(r), ship_texture_center};
+    return ship_t{{p, v, h}};
 }
 
-auto create_boids(gfx::gfx &gfx, gfx::renderer &r) -> boids_t {
-    boids_t boids{{world_rect, number_of_boids, quad_tree_max_depth},
-                  create_boid_texture(r),
-                  boid_texture_center};
-    for(size_t i = 0; i < number_of_boids; ++i) {
-        rect<double> position = {{gfx.uniform_random_between(0, world_width),
-                                  gfx.uniform_random_between(0, world_height)},
-                                 static_cast<vec2d>(boid_texture_size)};
-        rect<double> rect     = {position.position, boid_rect.size};
-        double       speed =
-            gfx.uniform_random_between(boid_max_speed * 0.3,  // NOLINT
-                                       boid_max_speed * 0.5); // NOLINT
-        double heading = gfx.uniform_random_between(0, M_PI * 2);
-        double separation =
-            gfx.uniform_random_between(boid_average_separation * 0.8,  // NOLINT
-                                       boid_average_separation * 1.3); // NOLINT
-        double speed_var = gfx.uniform_random_between(0.75, 1.25);     // NOLINT
-        vec2d  velocity  = {speed * cos(heading), speed * sin(heading)};
-        boids.entities.insert(
-            {position, velocity, heading, separation, speed_var}, rect);
-    }
-    return boids;
+auto random_boid(counter_rng const &rng, uint64_t i) -> entity_t {
+    // NOLINTBEGIN(readability-magic-numbers)
+    rect<double> position   = {{rng.uniform_between(i, 0, 0, world_width),
+                                rng.uniform_between(i, 1, 0, world_height)},
+                               static_cast<vec2d>(boid_texture_size)};
+    double       speed      = rng.uniform_between(i, 2, boid_max_speed * 0.3,
+                                                  boid_max_speed * 0.5);
+    double       heading    = rng.uniform_between(i, 3, 0, M_PI * 2);
+    double       separation = rng.uniform_between(
+        i, 4, boid_average_separation * 0.8, boid_average_separation * 1.3);
+    double speed_var = rng.uniform_between(i, 5, 0.75, 1.25);
+    // NOLINTEND(readability-magic-numbers)
+    vec2d velocity = {speed * cos(heading), speed * sin(heading)};
+    return {position, velocity, heading, separation, speed_var};
+}
+
+auto boid_key(entity_t const &e) -> vec2d { return e.p_rect.position; }
+
+auto boid_reach(rect<double> const &r) -> rect<double> {
+    return {r.position - boid_rect.size, r.size + boid_rect.size};
 }
 
-auto create_stars(gfx::gfx &gfx) -> star_tree {
-    star_tree star_tree{world_rect, number_of_stars, quad_tree_max_depth};
-    for(size_t i = 0; i < number_of_stars; ++i) {
-        vec2d        p{gfx.uniform_random_between(0, world_rect.size.x),
-                gfx.uniform_random_between(0, world_rect.size.y)};
-        rect<double> r{p, {1, 1}};
-        star_tree.insert(p, r);
-    }
-    return star_tree;
+auto create_boids(uint64_t seed, size_t threads) -> boids_t {
+    counter_rng           rng{seed, rng_stream_boids};
+    std::vector<entity_t> entities(number_of_boids);
+    parallel_for(
+        entities.size(), [&](size_t i) { entities[i] = random_boid(rng, i); },
+        threads);
+
+    boids_t boids{{world_rect, number_of_boids, quad_tree_max_depth}};
+    boids.entities.preallocate_nodes();
+    boids.entities.insert_range(entities, boid_key);
+    return boids;
 }
 
-auto create_shots(gfx::renderer &r) -> shots_t {
-    return {create_shot_texture(r), static_cast<vec2d>(shot_texture_size) / 2};
+state::state(uint64_t seed, rect<double> view = window_rect)
+    : ship{create_ship()}, boids{create_boids(seed)}, stars{seed}, view(view),
+      boid_rng{seed, rng_stream_boids},
+      frame_tasks{std::min<size_t>(std::thread::hardware_concurrency(),
+                                   frame_task_threads)} {
+    shots.entities.reserve(max_shots);
+    explosions.reserve(max_explosions);
+    scratch.boids.reserve(number_of_boids);
+    scratch.due.reserve(number_of_boids);
+    scratch.nearest.reserve(flock_neighbours);
 }
 
-state::state(gfx::gfx &gfx, gfx::renderer &r, rect<double> view = window_rect)
-    : ship{create_ship(r)}, boids{create_boids(gfx, r)}, shots{create_shots(r)},
-      stars{create_stars(gfx)}, view(view) {}
+assets_t::assets_t(gfx::renderer &r)
+    : ship{create_ship_texture(r), ship_texture_center},
+      boid{create_boid_texture(r), boid_texture_center},
+      shot{create_shot_texture(r), static_cast<vec2d>(shot_texture_size) / 2},
+      font{gfx::open_font(DATA_PATH "/lcd-font/LCD14.ttf", info_font_size)},
+      heatmap{gfx::create_texture(r, static_cast<int>(heatmap_columns),
+                                  static_cast<int>(heatmap_rows))} {}
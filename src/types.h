@@ -1,11 +1,20 @@
 #pragma once
 
 #include <bitset>
+#include <optional>
+#include <thread>
+
+#include <SDL.h>
 #include <gfx/font.h>
 #include <gfx/gfx.h>
 
+#include "alloc_tracker.h"
+#include "pipeline.h"
 #include "quad_tree.h"
+#include "random.h"
 #include "rect.h"
+#include "star_field.h"
+#include "task_graph.h"
 #include "vec2d.h"
 
 using vec2d = vec2d_t<double>;
@@ -16,9 +25,10 @@ struct entity_t {
     rect<double> p_rect{};
     vec2d        velocity{};
     vec2d        acceleration{};
-    double       heading{};
+    double       heading{}; // boids derive theirs from velocity when drawn
     double       separation{};
     double       speed_variance{};
+    double       pending_time{}; // boids, seconds not yet simulated
     bool         exploded{false};
 
     entity_t()                                     = default;
@@ -34,17 +44,41 @@ struct entity_t {
 };
 
 struct ship_t {
-    entity_t                      entity;
-    std::shared_ptr<gfx::texture> texture;
-    vec2d                         texture_center;
+    entity_t entity;
+    bool     present{true}; // boids only avoid a ship that is there
 };
 
-using entity_tree = dynamic_quad_tree<double, entity_t>;
+// Running totals kept in every node of the boid tree, so that a whole subtree
+// can stand in for its boids in alignment and cohesion.
+struct flock_summary {
+    size_t count{};
+    vec2d  position_sum{};
+    vec2d  velocity_sum{};
+
+    static auto of(entity_t const &e, vec2d const & /*p*/) -> flock_summary {
+        return {1, e.p_rect.position, e.velocity};
+    }
+
+    auto operator+=(flock_summary const &s) -> flock_summary & {
+        count        += s.count;
+        position_sum += s.position_sum;
+        velocity_sum += s.velocity_sum;
+        return *this;
+    }
+
+    auto operator-=(flock_summary const &s) -> flock_summary & {
+        count        -= s.count;
+        position_sum -= s.position_sum;
+        velocity_sum -= s.velocity_sum;
+        return *this;
+    }
+};
+
+// Boids are kept by their position, the centre they are drawn around.
+using entity_tree = dynamic_point_tree<double, entity_t, flock_summary>;
 
 struct boids_t {
-    entity_tree                   entities;
-    std::shared_ptr<gfx::texture> texture;
-    vec2d                         texture_center;
+    entity_tree entities;
 };
 
 struct shot_t {
@@ -58,9 +92,6 @@ struct shot_t {
 };
 
 struct shots_t {
-    std::shared_ptr<gfx::texture> texture;
-    vec2d                         texture_center;
-
     std::vector<shot_t> entities;
 };
 
@@ -93,33 +124,182 @@ enum key {
     key_new_boid,
     key_pause,
     key_help,
+    key_approximate,
+    key_lod,
+    key_topological,
     key_count
 };
 
-using star_tree = static_quad_tree<double, vec2d>;
+enum phase {
+    phase_input = 0,
+    phase_boid_pairs,
+    phase_boid_acceleration,
+    phase_explosions,
+    phase_boid_positions,
+    phase_shots,
+    phase_hits,
+    phase_ship,
+    phase_tidy,
+    phase_snapshot,
+    phase_count
+};
+
+constexpr std::array<char const *, phase_count> phase_names{
+    "INP", "PAIR", "ACC", "EXP", "POS", "SHOT", "HIT", "SHIP", "TIDY", "SNAP"};
+
+// A boid's neighbour sums for alignment, cohesion and separation.
+struct flock_totals {
+    vec2d alignment{};
+    int   alignment_num{};
+    vec2d cohesion{};
+    int   cohesion_num{};
+    vec2d separation{};
+};
+
+// The pairs of boids in range are found in this many tasks at once, each
+// summing into its own flock_totals by handle index.
+constexpr size_t flock_pair_tasks = 4;
+
+// Buffers kept from frame to frame so that the hot path doesn't allocate.
+struct scratch_t {
+    std::vector<entity_tree::handle> boids;
+    std::vector<entity_tree::handle> due;
+    std::vector<entity_tree::handle> neighbours;
+    std::vector<entity_tree::handle> hits;
+    std::vector<entity_tree::handle> visible;
+    std::vector<entity_tree::neighbour> nearest;
+    entity_tree::knn_frontier           frontier;
+    std::array<std::vector<flock_totals>, flock_pair_tasks> flock;
+    std::array<double, flock_pair_tasks>                    flock_seconds{};
+    std::array<alloc_stats, flock_pair_tasks>               flock_allocations{};
+    bool                                                    flock_paired{};
+};
+
+// Level of detail scheduling. Boids far from anything seen are simulated in
+// turn, one in every interval of them each frame, with the interval chosen to
+// keep boid updates within boid_update_budget.
+struct lod_t {
+    size_t interval{1};
+    size_t near{};
+    size_t distant{};
+    double seconds_per_boid{};
+};
 
 struct state {
-    vec2d                         mouse_position{};
-    uint32_t                      mouse_buttons{};
-    ship_t                        ship;
-    boids_t                       boids;
-    shots_t                       shots;
-    std::vector<explosion_t>      explosions;
-    star_tree                     stars;
-    time_point                    last_fired{};
-    std::bitset<key_count>        keys_pressed{};
-    time_point                    frame_start_time;
-    double                        frame_time{};
-    rect<double>                  view;
+    vec2d                                mouse_position{};
+    uint32_t                             mouse_buttons{};
+    bool                                 shift{false};
+    ship_t                               ship;
+    boids_t                              boids;
+    shots_t                              shots;
+    std::vector<explosion_t>             explosions;
+    star_field                           stars;
+    time_point                           last_fired{};
+    std::bitset<key_count>               keys_pressed{};
+    time_point                           frame_start_time;
+    double                               frame_time{};
+    size_t                               frame_count{};
+    rect<double>                         view;
+    bool                                 show_fps{false};
+    bool                                 quit{false};
+    bool                                 paused{false};
+    bool                                 minimized{false};
+    bool                                 idle{false};
+    bool                                 help{false};
+    bool                                 approximate_flocking{false};
+    bool                                 topological_flocking{false};
+    bool                                 lod_simulation{true};
+    lod_t                                lod;
+    counter_rng                          boid_rng;
+    uint64_t                             boids_spawned{};
+    scratch_t                            scratch;
+    std::array<alloc_stats, phase_count> allocations{};
+    std::array<double, phase_count>      phase_seconds{};
+    task_graph                           frame_tasks;
+
+    explicit state(uint64_t seed, rect<double> view);
+};
+
+auto random_boid(counter_rng const &rng, uint64_t i) -> entity_t;
+auto boid_key(entity_t const &e) -> vec2d;
+
+// The boids a world starts with, drawn over threads threads. The same seed
+// gives the same boids whatever the number of threads.
+auto create_boids(uint64_t seed,
+                  size_t   threads = std::thread::hardware_concurrency())
+    -> boids_t;
+
+// Where a boid's position has to be for its sprite's rect to overlap r.
+auto boid_reach(rect<double> const &r) -> rect<double>;
+
+// Boids per cell of a grid over the view, cells of 10 by 10 window pixels.
+// Drawn instead of the boids themselves when zoomed far out.
+constexpr size_t heatmap_columns = 128;
+constexpr size_t heatmap_rows    = 96;
+using heatmap_t = std::array<uint32_t, heatmap_columns * heatmap_rows>;
+
+struct sprite_t {
+    std::shared_ptr<gfx::texture> texture;
+    vec2d                         texture_center;
+};
+
+// Everything drawing needs that the simulation doesn't, owned by the render
+// thread.
+struct assets_t {
+    sprite_t                      ship;
+    sprite_t                      boid;
+    sprite_t                      shot;
     std::shared_ptr<gfx::font>    font;
+    std::shared_ptr<gfx::texture> heatmap;
     std::shared_ptr<gfx::texture> pause_text{};
     vec2d                         pause_position{};
     std::shared_ptr<gfx::texture> help_text{};
     vec2d                         help_position{};
-    bool                          show_fps{false};
-    bool                          quit{false};
-    bool                          paused{false};
-    bool                          help{false};
+    std::vector<double>           headings;
+    alloc_stats                   render_allocations{};
+
+    explicit assets_t(gfx::renderer &r);
+};
+
+// What the render thread needs of one simulated frame. Copied out of the
+// state at the end of each step, only boids and stars in view are included.
+struct frame_t {
+    rect<double>                         view;
+    std::vector<vec2d>                   stars;
+    std::vector<vec2d>                   boid_positions;
+    std::vector<vec2d>                   boid_velocities;
+    bool                                 boid_heatmap{false};
+    heatmap_t                            heatmap{};
+    std::vector<shot_t>                  shots;
+    std::vector<explosion_t>             explosions;
+    entity_t                             ship;
+    size_t                               boids_left{};
+    double                               frame_time{};
+    size_t                               lod_interval{};
+    std::bitset<key_count>               keys_pressed{};
+    bool                                 show_fps{false};
+    bool                                 paused{false};
+    bool                                 idle{false};
+    bool                                 help{false};
+    std::array<alloc_stats, phase_count> allocations{};
+    size_t                               alloc_violations{};
+};
+
+// An SDL event on its way to the simulation thread, along with the mouse
+// and modifier state when it was polled. Sent without an event once per
+// rendered frame to keep those current.
+struct input_t {
+    std::optional<SDL_Event> event;
+    vec2d                    mouse_position;
+    uint32_t                 mouse_buttons;
+    bool                     shift;
+};
+
+constexpr size_t input_queue_size = 256;
 
-    explicit state(gfx::gfx &gfx, gfx::renderer &r, rect<double> view);
+struct pipeline_t {
+    spsc_queue<input_t, input_queue_size> input;
+    triple_buffer<frame_t>                frames;
+    std::atomic<bool>                     quit{false};
+    std::atomic<uint32_t>                 inputs{}; // sent, to wait on
 };
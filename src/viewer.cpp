@@ -0,0 +1,243 @@
+// Renders the frames flox_stream sends, read from standard input or from a
+// Unix socket flox_stream listens on.
+//
+//   flox_stream | flox_viewer [--world]
+//   flox_viewer --socket PATH [--world]
+//
+// --world shows the whole world instead of the simulation's view. Stars
+// aren't sent, they are made here from the seed in the stream header.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+#include <fmt/format.h>
+#include <gfx/gfx.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "constants.h"
+#include "pipeline.h"
+#include "render.h"
+#include "star_field.h"
+#include "stream.h"
+#include "types.h"
+
+namespace {
+
+constexpr int    poll_timeout_ms   = 100;
+constexpr size_t read_buffer_size  = 1 << 16;
+constexpr size_t max_payload_bytes = 1 << 28;
+
+struct options {
+    char const *socket_path{};
+    bool        whole_world{false};
+};
+
+auto parse(int argc, char **argv) -> options {
+    options opt;
+    for(int i = 1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if(arg == "--socket" && i + 1 < argc) {
+            opt.socket_path = argv[++i];
+        } else if(arg == "--world") {
+            opt.whole_world = true;
+        }
+    }
+    return opt;
+}
+
+auto connect_to(char const *path) -> int {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if(std::string_view{path}.size() >= sizeof addr.sun_path) {
+        fmt::print(stderr, "socket path too long: {}\n", path);
+        return -1;
+    }
+    std::snprintf(addr.sun_path, sizeof addr.sun_path, "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Buffered reads that give up when the stream ends or quit is set, which
+// is checked while waiting for more.
+class stream_reader {
+    int                      m_fd;
+    std::atomic<bool> const &m_quit;
+    std::vector<uint8_t>     m_buffer;
+    size_t                   m_pos{};
+    size_t                   m_end{};
+
+    auto fill() -> bool {
+        while(!m_quit.load(std::memory_order_relaxed)) {
+            pollfd p{m_fd, POLLIN, 0};
+            int    ready = poll(&p, 1, poll_timeout_ms);
+            if(ready < 0 && errno != EINTR) {
+                return false;
+            }
+            if(ready <= 0) {
+                continue;
+            }
+            auto n = ::read(m_fd, m_buffer.data(), m_buffer.size());
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0) {
+                return false;
+            }
+            m_pos = 0;
+            m_end = static_cast<size_t>(n);
+            return true;
+        }
+        return false;
+    }
+
+  public:
+    stream_reader(int fd, std::atomic<bool> const &quit)
+        : m_fd(fd), m_quit(quit), m_buffer(read_buffer_size) {}
+
+    auto read(uint8_t *out, size_t size) -> bool {
+        while(size > 0) {
+            if(m_pos == m_end && !fill()) {
+                return false;
+            }
+            auto n = std::min(size, m_end - m_pos);
+            std::copy_n(m_buffer.data() + m_pos, n, out);
+            m_pos += n;
+            out   += n;
+            size  -= n;
+        }
+        return true;
+    }
+
+    auto varint(uint64_t &v) -> bool {
+        v = 0;
+        for(unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t b = 0;
+            if(!read(&b, 1)) {
+                return false;
+            }
+            v |= static_cast<uint64_t>(b & 0x7fU) << shift;
+            if((b & 0x80U) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Decodes frames as they arrive and hands the latest to the render thread.
+void receive(stream_reader &in, triple_buffer<frame_t> &frames,
+             std::atomic<bool> &quit, bool whole_world) {
+    stream_decoder       decoder;
+    std::vector<uint8_t> payload;
+    uint64_t             size = 0;
+    while(in.varint(size)) {
+        if(size > max_payload_bytes) {
+            fmt::print(stderr, "frame too large: {} bytes\n", size);
+            break;
+        }
+        payload.resize(size);
+        if(!in.read(payload.data(), size)) {
+            break;
+        }
+        if(!decoder.decode(payload, frames.write_slot(), whole_world)) {
+            fmt::print(stderr, "malformed frame\n");
+            break;
+        }
+        frames.publish();
+    }
+    quit = true;
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    auto opt = parse(argc, argv);
+    int  fd  = STDIN_FILENO;
+    if(opt.socket_path != nullptr) {
+        fd = connect_to(opt.socket_path);
+        if(fd < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::atomic<bool>                       quit{false};
+    stream_reader                           in{fd, quit};
+    std::array<uint8_t, stream_header_size> header_bytes{};
+    stream_header                           header;
+    if(!in.read(header_bytes.data(), header_bytes.size()) ||
+       !decode_header(header_bytes, header)) {
+        fmt::print(stderr, "not a flox stream of version {}\n", stream_version);
+        return EXIT_FAILURE;
+    }
+
+    gfx::gfx gfx{};
+    auto     window = gfx::create_window(NAME " viewer " VERSION,
+                                         window_width, window_height, true);
+    auto &renderer = window->get_renderer();
+
+    assets_t   assets{renderer};
+    star_field stars{header.seed};
+    gfx::show_cursor(/*visible=*/false);
+
+    triple_buffer<frame_t> frames;
+    std::thread receiver{[&] { receive(in, frames, quit, opt.whole_world); }};
+
+    vec2d mouse_position;
+    auto  last_render = std::chrono::steady_clock::now();
+    auto  handle      = [&](SDL_Event const &e) {
+        if(e.type == SDL_QUIT ||
+           (e.type == SDL_KEYDOWN && (e.key.keysym.sym == SDLK_ESCAPE ||
+                                      e.key.keysym.sym == SDLK_q))) {
+            quit = true;
+        }
+    };
+    while(!quit.load(std::memory_order_relaxed)) {
+        gfx::get_mouse_state(mouse_position.x, mouse_position.y);
+        SDL_Event e;
+        while(SDL_PollEvent(&e) != 0) {
+            handle(e);
+        }
+        if(!frames.acquire()) {
+            // blocks on input, the next frame is at most frame_wait_ms late
+            if(SDL_WaitEventTimeout(&e, frame_wait_ms) != 0) {
+                handle(e);
+            }
+            continue;
+        }
+        auto &f = frames.read_slot();
+        stars.items(f.stars, f.view);
+        auto now = std::chrono::steady_clock::now();
+        render(f, assets, renderer, mouse_position,
+               std::chrono::duration<double>(now - last_render).count());
+        renderer.present();
+        last_render = now;
+    }
+
+    receiver.join();
+    if(fd != STDIN_FILENO) {
+        close(fd);
+    }
+    return EXIT_SUCCESS;
+}
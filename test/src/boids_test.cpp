@@ -0,0 +1,56 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <bit>
+
+#include "constants.h"
+#include "types.h"
+
+namespace {
+
+// Bit for bit, as doubles can't be compared with ==.
+auto same(double a, double b) -> bool {
+    return std::bit_cast<uint64_t>(a) == std::bit_cast<uint64_t>(b);
+}
+
+auto same(entity_t const &a, entity_t const &b) -> bool {
+    return same(a.p_rect.position.x, b.p_rect.position.x) &&
+           same(a.p_rect.position.y, b.p_rect.position.y) &&
+           same(a.p_rect.size.x, b.p_rect.size.x) &&
+           same(a.p_rect.size.y, b.p_rect.size.y) &&
+           same(a.velocity.x, b.velocity.x) &&
+           same(a.velocity.y, b.velocity.y) && same(a.heading, b.heading) &&
+           same(a.separation, b.separation) &&
+           same(a.speed_variance, b.speed_variance);
+}
+
+} // namespace
+
+TEST_CASE("Boids come out the same however many threads draw them",
+          "[boids]") {
+    auto one  = create_boids(world_seed, 1);
+    auto four = create_boids(world_seed, 4);
+    REQUIRE(one.entities.size() == number_of_boids);
+    REQUIRE(four.entities.size() == number_of_boids);
+
+    auto in_one  = one.entities.items();
+    auto in_four = four.entities.items();
+    REQUIRE(in_one.size() == in_four.size());
+    for(size_t i = 0; i < in_one.size(); ++i) {
+        REQUIRE(same(one.entities[in_one[i]], four.entities[in_four[i]]));
+    }
+}
+
+TEST_CASE("Another seed gives other boids", "[boids]") {
+    auto first  = create_boids(world_seed, 4);
+    auto second = create_boids(world_seed + 1, 4);
+
+    auto   in_first  = first.entities.items();
+    auto   in_second = second.entities.items();
+    size_t differing = 0;
+    for(size_t i = 0; i < in_first.size(); ++i) {
+        if(!same(first.entities[in_first[i]], second.entities[in_second[i]])) {
+            ++differing;
+        }
+    }
+    CHECK(differing == in_first.size());
+}
@@ -0,0 +1,41 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <numeric>
+
+#include "constants.h"
+#include "simulation.h"
+
+TEST_CASE("Zoomed out, boids are counted into a heatmap", "[heatmap]") {
+    state st{world_seed, world_rect};
+    st.frame_time = 1.0 / 60;
+    for(int i = 0; i < 30; ++i) {
+        update(st);
+    }
+
+    frame_t f;
+    snapshot(st, f);
+    REQUIRE(f.boid_heatmap);
+    CHECK(f.boid_positions.empty());
+    auto total = std::accumulate(f.heatmap.begin(), f.heatmap.end(), size_t{});
+    CHECK(total == st.boids.entities.size(world_rect));
+
+    st.view = window_rect;
+    snapshot(st, f);
+    CHECK(!f.boid_heatmap);
+    CHECK(f.boid_positions.size() ==
+          st.boids.entities.items(boid_reach(st.view)).size());
+}
+
+TEST_CASE("Boids on the far edges of the view count in the last cells",
+          "[heatmap]") {
+    state    st{world_seed, world_rect};
+    entity_t b{};
+    b.p_rect.position = world_rect.position + world_rect.size;
+    st.boids.entities.insert(b, boid_key(b));
+
+    frame_t f;
+    snapshot(st, f);
+    REQUIRE(f.boid_heatmap);
+    auto total = std::accumulate(f.heatmap.begin(), f.heatmap.end(), size_t{});
+    CHECK(total == st.boids.entities.size(world_rect));
+}
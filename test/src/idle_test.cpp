@@ -0,0 +1,52 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "constants.h"
+#include "simulation.h"
+
+namespace {
+
+auto window_event(uint8_t event) -> input_t {
+    SDL_Event e{};
+    e.type         = SDL_WINDOWEVENT;
+    e.window.event = event;
+    return {e, {}, 0, false};
+}
+
+} // namespace
+
+TEST_CASE("Paused or minimized, steps go idle", "[idle]") {
+    state st{world_seed, window_rect};
+    st.ship.entity.velocity = {};
+
+    step(st);
+    CHECK(!st.idle);
+
+    st.paused   = true;
+    auto frames = st.frame_count;
+    step(st);
+    CHECK(st.idle);
+    CHECK(st.frame_count == frames);
+
+    // zooming changes the frame while paused
+    st.keys_pressed.set(key_zoom_in);
+    step(st);
+    CHECK(!st.idle);
+    st.keys_pressed.reset(key_zoom_in);
+    step(st);
+    CHECK(st.idle);
+
+    st.paused = false;
+    handle_input(st, window_event(SDL_WINDOWEVENT_MINIMIZED));
+    step(st);
+    CHECK(st.idle);
+    CHECK(st.frame_count == frames);
+
+    handle_input(st, window_event(SDL_WINDOWEVENT_RESTORED));
+    step(st);
+    CHECK(!st.idle);
+    CHECK(st.frame_count == frames + 1);
+
+    frame_t f;
+    snapshot(st, f);
+    CHECK(f.idle == st.idle);
+}
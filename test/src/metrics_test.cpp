@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <bit>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "metrics.h"
+
+namespace {
+
+auto test_name() -> std::string {
+    return "/flox-metrics-test-" + std::to_string(getpid());
+}
+
+} // namespace
+
+TEST_CASE("Metrics reach a reader through shared memory", "[metrics]") {
+    auto name = test_name();
+    {
+        metrics_reader early{name.c_str()};
+        CHECK(!early.is_open());
+    }
+
+    metrics_writer writer{name.c_str()};
+    REQUIRE(writer.is_open());
+    metrics_sample out;
+    out.frame            = 42;
+    out.frame_time       = 1.0 / 60;
+    out.phase_seconds[1] = 0.002;
+    out.boids            = 4999;
+    out.index_depth      = 7;
+    writer.publish(out);
+
+    metrics_reader reader{name.c_str()};
+    REQUIRE(reader.is_open());
+    metrics_sample in;
+    REQUIRE(reader.read(in));
+    CHECK(in.frame == 42);
+    CHECK(in.boids == 4999);
+    CHECK(in.index_depth == 7);
+    CHECK(std::bit_cast<uint64_t>(in.phase_seconds[1]) ==
+          std::bit_cast<uint64_t>(out.phase_seconds[1]));
+}
+
+TEST_CASE("Readers never see a torn sample", "[metrics]") {
+    auto           name = test_name();
+    metrics_writer writer{name.c_str()};
+    metrics_reader reader{name.c_str()};
+    REQUIRE(reader.is_open());
+
+    // every field of a sample holds the same value
+    std::atomic<bool> done{false};
+    std::thread       publisher{[&] {
+        for(uint64_t i = 1; i < 200000; ++i) {
+            metrics_sample s;
+            s.frame = s.boids = s.shots = s.explosions = s.index_nodes = i;
+            writer.publish(s);
+        }
+        done = true;
+    }};
+    size_t reads = 0;
+    while(!done) {
+        metrics_sample s;
+        if(!reader.read(s)) {
+            continue;
+        }
+        ++reads;
+        REQUIRE(s.boids == s.frame);
+        REQUIRE(s.shots == s.frame);
+        REQUIRE(s.explosions == s.frame);
+        REQUIRE(s.index_nodes == s.frame);
+    }
+    publisher.join();
+    CHECK(reads > 0);
+}
+
+TEST_CASE("A second writer publishes under its own name", "[metrics]") {
+    auto           name = test_name();
+    metrics_writer first{name.c_str()};
+    REQUIRE(first.is_open());
+    metrics_sample s;
+    s.frame = 1;
+    first.publish(s);
+    {
+        metrics_writer second{name.c_str()};
+        REQUIRE(second.is_open());
+        CHECK(second.name() != name);
+        s.frame = 2;
+        second.publish(s);
+    }
+
+    // the first's segment is untouched and still there
+    metrics_reader reader{name.c_str()};
+    REQUIRE(reader.is_open());
+    metrics_sample in;
+    REQUIRE(reader.read(in));
+    CHECK(in.frame == 1);
+}
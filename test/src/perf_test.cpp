@@ -0,0 +1,168 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "constants.h"
+#include "simulation.h"
+#include "types.h"
+
+namespace {
+
+constexpr double   frame_time        = 1.0 / 60;
+constexpr size_t   frames            = 30;
+constexpr uint64_t scenario_seed     = 0x5ca1ab1e;
+constexpr double   default_tolerance = 0.5;
+
+struct result_t {
+    uint64_t checksum{};
+    double   ns_per_boid_update{};
+};
+
+auto checksum(state &st) -> uint64_t {
+    uint64_t h   = 0xcbf29ce484222325U;
+    auto     add = [&h](double v) {
+        h = (h ^ std::bit_cast<uint64_t>(v)) * 0x100000001b3U;
+    };
+    for(auto handle : st.boids.entities.items()) {
+        auto &b = st.boids.entities[handle];
+        add(b.p_rect.position.x);
+        add(b.p_rect.position.y);
+        add(b.velocity.x);
+        add(b.velocity.y);
+    }
+    for(auto const &expl : st.explosions) {
+        add(expl.pressure_left);
+    }
+    return h;
+}
+
+void gather(state &st, counter_rng const &rng, rect<double> const &area) {
+    uint64_t i = 0;
+    for(auto h : st.boids.entities.items()) {
+        auto &b           = st.boids.entities[h];
+        b.p_rect.position = {
+            rng.uniform_between(i, 0, area.position.x,
+                                area.position.x + area.size.x),
+            rng.uniform_between(i, 1, area.position.y,
+                                area.position.y + area.size.y)};
+        st.boids.entities.move(h, boid_key(b));
+        ++i;
+    }
+}
+
+template <typename Setup, typename PerFrame>
+auto run(Setup &&setup, PerFrame &&per_frame) -> result_t {
+    state st{scenario_seed, window_rect};
+    st.frame_time     = frame_time;
+    st.lod_simulation = false; // scheduled by timings, not reproducible
+    setup(st);
+
+    std::chrono::nanoseconds elapsed{};
+    size_t                   boid_updates{};
+    for(size_t f = 0; f < frames; ++f) {
+        per_frame(st, f);
+        boid_updates += st.boids.entities.size();
+        auto start   = std::chrono::steady_clock::now();
+        update(st);
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+    return {checksum(st), static_cast<double>(elapsed.count()) /
+                              static_cast<double>(boid_updates)};
+}
+
+auto scenario(std::string const &name) -> result_t {
+    counter_rng rng{scenario_seed, rng_stream_boids};
+    auto        nothing = [](state & /*st*/, size_t /*f*/) {};
+    if(name == "uniform") {
+        return run([](state & /*st*/) {}, nothing);
+    }
+    if(name == "dense_flock") {
+        rect<double> area{world_rect.size / 2 - vec2d{500, 500}, {1000, 1000}};
+        return run([&](state &st) { gather(st, rng, area); }, nothing);
+    }
+    // explosion_barrage
+    return run([](state & /*st*/) {},
+               [&rng](state &st, size_t f) {
+                   for(uint64_t i = f * 4; i < f * 4 + 4; ++i) {
+                       explode(st, {rng.uniform_between(i, 6, 0, world_width),
+                                    rng.uniform_between(i, 7, 0,
+                                                        world_height)});
+                   }
+               });
+}
+
+auto baselines() -> std::map<std::string, result_t> {
+    std::map<std::string, result_t> result;
+    std::ifstream                   in{FLOX_PERF_BASELINES};
+    std::string                     line;
+    while(std::getline(in, line)) {
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields{line};
+        std::string        name;
+        result_t           known;
+        if(fields >> name >> known.ns_per_boid_update >> std::hex >>
+           known.checksum) {
+            result[name] = known;
+        }
+    }
+    return result;
+}
+
+auto tolerance() -> double {
+    char const *env = std::getenv("FLOX_PERF_TOLERANCE"); // NOLINT
+    return env != nullptr ? std::stod(env) : default_tolerance;
+}
+
+void check(std::string const &name) {
+    auto first  = scenario(name);
+    auto second = scenario(name);
+    REQUIRE(first.checksum == second.checksum);
+
+    double ns = std::min(first.ns_per_boid_update, second.ns_per_boid_update);
+    INFO(name << ": " << ns << " ns per boid update, checksum " << std::hex
+              << first.checksum);
+#ifdef NDEBUG
+    auto known = baselines();
+    REQUIRE(known.contains(name));
+    // floating point results can change with the compiler's optimizations
+    CHECK(first.checksum == known[name].checksum);
+    CHECK(ns <= known[name].ns_per_boid_update * (1 + tolerance()));
+#else
+    WARN("results are only compared against baselines in optimized builds");
+#endif
+}
+
+} // namespace
+
+TEST_CASE("Uniform spread", "[perf]") { check("uniform"); }
+
+TEST_CASE("Single dense flock", "[perf]") { check("dense_flock"); }
+
+TEST_CASE("Explosion barrage", "[perf]") { check("explosion_barrage"); }
+
+TEST_CASE("Steady state doesn't allocate", "[perf]") {
+    if(!allocations_tracked()) {
+        WARN("needs FLOX_TRACK_ALLOCATIONS");
+        return;
+    }
+    state st{scenario_seed, window_rect};
+    frame_t f;
+    for(size_t i = 0; i < steady_state_frames; ++i) {
+        step(st);
+        snapshot(st, f);
+    }
+    auto before = thread_allocations();
+    for(size_t i = 0; i < frames; ++i) {
+        step(st);
+        snapshot(st, f);
+    }
+    CHECK((thread_allocations() - before).count == 0);
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "pipeline.h"
+
+TEST_CASE("A full queue refuses items until one is taken", "[pipeline]") {
+    spsc_queue<int, 4> q;
+    for(int i = 0; i < 4; ++i) {
+        REQUIRE(q.push(i));
+    }
+    CHECK(!q.push(4));
+    CHECK(q.pop() == 0);
+    CHECK(q.push(4));
+    for(int i = 1; i <= 4; ++i) {
+        CHECK(q.pop() == i);
+    }
+    CHECK(!q.pop());
+}
+
+TEST_CASE("Queued items arrive in order across threads", "[pipeline]") {
+    constexpr uint64_t count = 200000;
+
+    // small, so the producer keeps finding it full. Both sides yield while
+    // waiting, or on one core each would spin out its time slice.
+    spsc_queue<uint64_t, 8> q;
+    size_t                  full = 0;
+    std::thread             producer{[&] {
+        for(uint64_t i = 0; i < count; ++i) {
+            while(!q.push(i)) {
+                ++full;
+                std::this_thread::yield();
+            }
+        }
+    }};
+    uint64_t expected = 0;
+    while(expected < count) {
+        auto i = q.pop();
+        if(!i) {
+            std::this_thread::yield();
+            continue;
+        }
+        REQUIRE(*i == expected);
+        ++expected;
+    }
+    producer.join();
+    CHECK(!q.pop());
+    CHECK(full > 0);
+}
+
+TEST_CASE("The reader only sees whole frames, never older ones",
+          "[pipeline]") {
+    constexpr uint64_t frames = 20000;
+
+    // every word of a frame holds its number, a torn one has several
+    using frame = std::array<uint64_t, 4096>;
+    triple_buffer<frame> buffer;
+    std::atomic<bool>    done{false};
+    std::thread          writer{[&] {
+        for(uint64_t n = 1; n <= frames; ++n) {
+            buffer.write_slot().fill(n);
+            buffer.publish();
+        }
+        done = true;
+    }};
+    uint64_t last  = 0;
+    size_t   reads = 0;
+    while(true) {
+        // nothing fresh after the writer is done means all has been seen
+        bool finished = done;
+        if(!buffer.acquire()) {
+            if(finished) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        auto const &f = buffer.read_slot();
+        for(auto word : f) {
+            REQUIRE(word == f[0]);
+        }
+        REQUIRE(f[0] > last);
+        last = f[0];
+        ++reads;
+    }
+    writer.join();
+    CHECK(last == frames);
+    CHECK(reads > 0);
+}
@@ -0,0 +1,309 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <vector>
+
+#include "quad_tree.h"
+
+using tree = dynamic_quad_tree<double, int>;
+
+constexpr rect<double>    area{{0, 0}, {1024, 1024}};
+constexpr vec2d_t<double> unit{1, 1};
+
+TEST_CASE("Counts follow insert, move and remove", "[quad_tree]") {
+    tree t{area, 16, 5};
+    for(int i = 0; i < 8; ++i) {
+        t.insert(i, {{100.0 * i + 10, 10}, unit});
+    }
+    REQUIRE(t.size() == 8);
+    REQUIRE(t.size(area) == 8);
+    REQUIRE(t.size({{0, 0}, {400, 100}}) == 4);
+
+    auto items = t.items();
+    t.move(items[0], {{900, 900}, unit});
+    REQUIRE(t.size({{0, 0}, {400, 100}}) == 3);
+    REQUIRE(t.size({{800, 800}, {200, 200}}) == 1);
+
+    t.remove(items[1]);
+    REQUIRE(t.size() == 7);
+    REQUIRE(t.size({{0, 0}, {400, 100}}) == 2);
+}
+
+TEST_CASE("Any finds objects and misses empty space", "[quad_tree]") {
+    tree t{area, 16, 5};
+    t.insert(1, {{500, 500}, {40, 40}});
+    REQUIRE(t.any({{530, 530}, unit}));
+    REQUIRE_FALSE(t.any({{600, 600}, unit}));
+
+    auto items = t.items();
+    t.remove(items[0]);
+    REQUIRE_FALSE(t.any(area));
+}
+
+TEST_CASE("Removal keeps storage dense and handles valid", "[quad_tree]") {
+    tree t{area, 64, 5};
+    for(int i = 0; i < 64; ++i) {
+        t.insert(i, {{16.0 * i, 1000.0 - 15.0 * i}, unit});
+    }
+    auto items = t.items();
+    for(size_t i = 0; i < items.size(); i += 3) {
+        t.remove(items[i]);
+    }
+    REQUIRE(t.size() == 42);
+    REQUIRE(t.items().size() == 42);
+    for(size_t i = 0; i < items.size(); ++i) {
+        REQUIRE(t.contains(items[i]) == (i % 3 != 0));
+        if(i % 3 != 0) {
+            REQUIRE(t[items[i]] == static_cast<int>(i));
+        }
+    }
+
+    t.sort_spatially();
+    REQUIRE(t.size(area) == 42);
+    REQUIRE(t[items[1]] == 1);
+
+    auto moved = t.items({{0, 900}, {200, 124}});
+    for(auto h : moved) {
+        t.move(h, {{1000, 10}, unit});
+    }
+    REQUIRE(t.size({{990, 0}, {34, 20}}) == moved.size());
+    for(auto h : t.items()) {
+        t.remove(h);
+    }
+    REQUIRE(t.size(area) == 0);
+    REQUIRE(t.empty());
+}
+
+TEST_CASE("Stale handles are detected and storage grows", "[quad_tree]") {
+    tree t{area, 4, 5};
+    auto first = t.insert(1, {{10, 10}, unit});
+    t.remove(first);
+    REQUIRE_FALSE(t.contains(first));
+    REQUIRE(t.get(first) == nullptr);
+
+    // reuses the slot, the old handle still doesn't see the new object
+    auto second = t.insert(2, {{10, 10}, unit});
+    REQUIRE(second.index == first.index);
+    REQUIRE_FALSE(t.contains(first));
+    REQUIRE(*t.get(second) == 2);
+    t.remove(first);
+    REQUIRE(t.size() == 1);
+
+    // well past the reserved capacity, with earlier handles still good
+    for(int i = 0; i < 1000; ++i) {
+        t.insert(i, {{i % 1000 + 0.5, 500}, unit});
+    }
+    REQUIRE(t.size() == 1001);
+    REQUIRE(*t.get(second) == 2);
+    REQUIRE(t.size({{0, 0}, {20, 20}}) == 1);
+}
+
+TEST_CASE("Loose trees answer queries like tight ones", "[quad_tree]") {
+    tree tight{area, 256, 5};
+    tree loose{area, 256, 5, 2};
+    for(int i = 0; i < 256; ++i) {
+        // every few objects straddle a split line of some node
+        double       x = (i * 37) % 1000;
+        double       y = (i * 91) % 1000;
+        rect<double> r{{x, y}, {24, 24}};
+        tight.insert(i, r);
+        loose.insert(i, r);
+    }
+    for(int i = 0; i < 64; ++i) {
+        double       x = (i * 53) % 900;
+        double       y = (i * 29) % 900;
+        rect<double> query{{x, y}, {64.0 + i, 80}};
+        REQUIRE(loose.size(query) == tight.size(query));
+        REQUIRE(loose.any(query) == tight.any(query));
+        REQUIRE(loose.items(query).size() == tight.items(query).size());
+    }
+    REQUIRE(loose.size(area) == 256);
+
+    auto items = loose.items();
+    for(auto iter : items) {
+        loose.move(iter, {{1000, 1000}, {24, 24}});
+    }
+    REQUIRE(loose.size({{990, 990}, {34, 34}}) == 256);
+}
+
+TEST_CASE("Bulk insert matches one at a time", "[quad_tree]") {
+    std::vector<int> objs(500);
+    for(int i = 0; i < 500; ++i) {
+        objs[static_cast<size_t>(i)] = i;
+    }
+    auto rect_of = [](int i) -> rect<double> {
+        double x = (i * 37) % 1000;
+        double y = (i * 91) % 1000;
+        return {{x, y}, {1.0 + i % 30, 1.0 + i % 20}};
+    };
+
+    tree single{area, 600, 6};
+    for(int i : objs) {
+        single.insert(i, rect_of(i));
+    }
+    tree bulk{area, 600, 6};
+    bulk.insert_range(objs, rect_of);
+
+    REQUIRE(bulk.size() == 500);
+    for(int i = 0; i < 50; ++i) {
+        double       x = (i * 53) % 900;
+        double       y = (i * 29) % 900;
+        rect<double> query{{x, y}, {100, 100}};
+        REQUIRE(bulk.size(query) == single.size(query));
+    }
+
+    // the locations handed back are usable
+    for(auto h : bulk.items()) {
+        bulk.move(h, {{10, 10}, unit});
+    }
+    REQUIRE(bulk.size({{0, 0}, {20, 20}}) == 500);
+}
+
+TEST_CASE("Stats slices add up to the whole", "[quad_tree]") {
+    tree t{area, 600, 6};
+    for(int i = 0; i < 500; ++i) {
+        double x = (i * 37) % 1000;
+        double y = (i * 91) % 1000;
+        t.insert(i, {{x, y}, {1.0 + i % 30, 1.0 + i % 20}});
+    }
+    t.insert(500, {{0, 0}, {1000, 1000}}); // stays in the root
+
+    auto whole = t.stats();
+    REQUIRE(whole.depth == 6);
+    REQUIRE(whole.max_contents >= 1);
+
+    quad_tree_stats sliced;
+    for(size_t slice = 0; slice < tree::stats_slices; ++slice) {
+        t.add_stats(sliced, slice);
+    }
+    REQUIRE(sliced.nodes == whole.nodes);
+    REQUIRE(sliced.depth == whole.depth);
+    REQUIRE(sliced.occupied == whole.occupied);
+    REQUIRE(sliced.max_contents == whole.max_contents);
+}
+
+TEST_CASE("Point trees find points by containment", "[quad_tree]") {
+    using point_tree = dynamic_point_tree<double, int>;
+    point_tree                   t{area, 600, 6};
+    std::vector<vec2d_t<double>> points;
+    for(int i = 0; i < 500; ++i) {
+        points.push_back({static_cast<double>((i * 37) % 1030) - 3,
+                          static_cast<double>((i * 91) % 1024)});
+    }
+    points.push_back({512, 512}); // on the split lines
+    points.push_back({0, 0});
+    std::vector<point_tree::handle> handles;
+    for(size_t i = 0; i < points.size(); ++i) {
+        handles.push_back(t.insert(static_cast<int>(i), points[i]));
+    }
+
+    auto brute = [&](rect<double> const &q) {
+        size_t n = 0;
+        for(auto const &p : points) {
+            if(p.x >= q.position.x && p.y >= q.position.y &&
+               p.x < q.position.x + q.size.x && p.y < q.position.y + q.size.y) {
+                ++n;
+            }
+        }
+        return n;
+    };
+    for(int i = 0; i < 50; ++i) {
+        double       x = (i * 53) % 1000 - 20;
+        double       y = (i * 29) % 1000;
+        rect<double> query{{x, y}, {100, 64}};
+        REQUIRE(t.size(query) == brute(query));
+        REQUIRE(t.items(query).size() == brute(query));
+        REQUIRE(t.any(query) == (brute(query) > 0));
+    }
+    REQUIRE(t.size({{512, 512}, unit}) == 1);
+    REQUIRE(t.size({{511, 511}, unit}) == 0);
+
+    // points outside the tree's rect stay at the root
+    REQUIRE(t.stats().depth == 6);
+    t.move(handles[0], {-50, -50});
+    REQUIRE(t.size({{-60, -60}, {20, 20}}) == 1);
+}
+
+TEST_CASE("Nearest neighbours match a full sort", "[quad_tree]") {
+    using point_tree = dynamic_point_tree<double, int>;
+    point_tree                      t{area, 600, 6};
+    std::vector<vec2d_t<double>>    points;
+    std::vector<point_tree::handle> handles;
+    for(int i = 0; i < 500; ++i) {
+        points.push_back({static_cast<double>((i * 37) % 1024),
+                          static_cast<double>((i * 91 + i / 7) % 1024)});
+        handles.push_back(t.insert(i, points.back()));
+    }
+
+    std::vector<point_tree::neighbour> found;
+    point_tree::knn_frontier           open;
+    for(int i = 0; i < 40; ++i) {
+        vec2d_t<double>     p{(i * 53) % 1100 - 40.0, (i * 29) % 1024 + 0.5};
+        std::vector<double> all;
+        for(auto const &q : points) {
+            all.push_back((q - p).mag_sq());
+        }
+        std::sort(all.begin(), all.end());
+
+        t.nearest(p, 7, found, open);
+        REQUIRE(found.size() == 7);
+        for(size_t k = 0; k < found.size(); ++k) {
+            REQUIRE(std::abs(found[k].first - all[k]) < 1e-9);
+        }
+    }
+
+    // accept() filters, and k larger than the tree returns everything
+    t.nearest(points[0], 3, found, open,
+              [&](point_tree::handle h) { return !(h == handles[0]); });
+    REQUIRE(found.size() == 3);
+    REQUIRE(found[0].first > 0);
+    t.nearest(points[0], 1000, found, open);
+    REQUIRE(found.size() == 500);
+}
+
+TEST_CASE("Pairs in range are found once each", "[quad_tree]") {
+    using point_tree = dynamic_point_tree<double, int>;
+    constexpr double radius = 40;
+
+    point_tree                   t{area, 600, 6};
+    std::vector<vec2d_t<double>> points;
+    for(int i = 0; i < 400; ++i) {
+        points.push_back({static_cast<double>((i * 37) % 1030) - 3,
+                          static_cast<double>((i * 91 + i / 5) % 1024)});
+        t.insert(i, points.back());
+    }
+    points.push_back({-20, 100}); // outside, held at the root
+    t.insert(400, points.back());
+    points.push_back({512, 512}); // on the split lines
+    t.insert(401, points.back());
+
+    size_t                 n = points.size();
+    std::vector<int>       expected(n * n);
+    std::vector<int>       found(n * n);
+    std::vector<int> const none(n * n);
+    for(size_t a = 0; a < n; ++a) {
+        for(size_t b = a + 1; b < n; ++b) {
+            if((points[a] - points[b]).mag_sq() < radius * radius) {
+                ++expected[a * n + b];
+            }
+        }
+    }
+    auto note = [&](point_tree::handle a, point_tree::handle b, double d) {
+        auto i = static_cast<size_t>(std::min(t[a], t[b]));
+        auto j = static_cast<size_t>(std::max(t[a], t[b]));
+        REQUIRE(std::abs(d - (points[i] - points[j]).mag_sq()) < 1e-9);
+        ++found[i * n + j];
+    };
+
+    t.pairs(radius, note);
+    REQUIRE(found == expected);
+    REQUIRE(found != none);
+
+    std::fill(found.begin(), found.end(), 0);
+    for(size_t slice = 0; slice < point_tree::pair_slices; ++slice) {
+        t.pairs(radius, note, slice);
+    }
+    REQUIRE(found == expected);
+}
@@ -0,0 +1,146 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "shard.h"
+#include "simulation.h"
+#include "types.h"
+
+namespace {
+
+constexpr double   frame_time  = 1.0 / 60;
+constexpr size_t   frames      = 60;
+constexpr uint64_t shard_seed  = 0x5a4d;
+constexpr double   max_drift   = 1e-6;
+constexpr size_t   test_shards = 4;
+
+// Boids keep their separation for life, which tells them apart.
+using boid_map = std::map<uint64_t, entity_t>;
+
+void collect(state &st, boid_map &out) {
+    for(auto h : st.boids.entities.items()) {
+        auto const &b = st.boids.entities[h];
+        out.emplace(std::bit_cast<uint64_t>(b.separation), b);
+    }
+}
+
+auto unsharded() -> boid_map {
+    state st{shard_seed, window_rect};
+    st.frame_time     = frame_time;
+    st.lod_simulation = false;
+    st.ship.present   = false;
+    for(size_t f = 0; f < frames; ++f) {
+        update(st);
+    }
+    boid_map result;
+    collect(st, result);
+    return result;
+}
+
+// Shards on threads, linked as they would be across processes.
+auto sharded(size_t count) -> boid_map {
+    std::vector<std::unique_ptr<state>> states;
+    std::vector<shard_t>                shards(count);
+    for(size_t i = 0; i < count; ++i) {
+        states.push_back(std::make_unique<state>(shard_seed, window_rect));
+        states[i]->frame_time = frame_time;
+        shards[i].index       = i;
+        shards[i].count       = count;
+        claim_strip(*states[i], shards[i]);
+    }
+    for(size_t i = 0; i + 1 < count; ++i) {
+        std::array<int, 2> fds{};
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+        shards[i].right    = fds[0];
+        shards[i + 1].left = fds[1];
+    }
+
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < count; ++i) {
+        threads.emplace_back([&st = *states[i], &sh = shards[i]] {
+            for(size_t f = 0; f < frames; ++f) {
+                update_shard(st, sh);
+            }
+        });
+    }
+    boid_map result;
+    for(size_t i = 0; i < count; ++i) {
+        threads[i].join();
+        collect(*states[i], result);
+        for(auto h : states[i]->boids.entities.items()) {
+            auto const &b = states[i]->boids.entities[h];
+            CHECK(shard_of(b.p_rect.position, count) == i);
+        }
+    }
+    for(auto const &sh : shards) {
+        for(int fd : {sh.left, sh.right}) {
+            if(fd != no_link) {
+                close(fd);
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("Strips cover the world", "[shard]") {
+    for(size_t count : {size_t{1}, size_t{3}, max_shards()}) {
+        double x = 0;
+        for(size_t i = 0; i < count; ++i) {
+            auto strip = shard_strip(i, count);
+            CHECK(std::abs(strip.position.x - x) < 1e-9);
+            CHECK(strip.size.x >= boid_cohesion_dist);
+            CHECK(shard_of(strip.position + strip.size / 2, count) == i);
+            x += strip.size.x;
+        }
+        CHECK(std::abs(x - world_width) < 1e-9);
+        CHECK(shard_of({-10, 0}, count) == 0);
+        CHECK(shard_of({world_width + 10, 0}, count) == count - 1);
+    }
+}
+
+TEST_CASE("Sharded simulation matches the single process one", "[shard]") {
+    auto whole  = unsharded();
+    auto shards = sharded(test_shards);
+
+    REQUIRE(shards.size() == whole.size());
+    double drift = 0;
+    for(auto const &[id, b] : whole) {
+        auto it = shards.find(id);
+        REQUIRE(it != shards.end());
+        auto const &s = it->second;
+        drift = std::max(drift, (s.p_rect.position - b.p_rect.position).mag());
+        drift = std::max(drift, (s.velocity - b.velocity).mag());
+    }
+    INFO("largest difference " << drift);
+    CHECK(drift < max_drift);
+}
+
+TEST_CASE("Shards have no ship for boids to avoid", "[shard]") {
+    state   st{shard_seed, window_rect};
+    shard_t sh;
+    auto    h = st.boids.entities.items().front();
+    auto   &b = st.boids.entities[h];
+    b.p_rect.position = st.ship.entity.p_rect.position + vec2d{100, 0};
+    b.velocity        = {};
+    st.boids.entities.move(h, boid_key(b));
+
+    vec2d const away{boid_max_accel, 0}; // straight off the ship
+    update_boid_acceleration(st, h);
+    CHECK((b.acceleration - away).mag() < 1e-9);
+    claim_strip(st, sh);
+    CHECK(!st.ship.present);
+    update_boid_acceleration(st, h);
+    CHECK((b.acceleration - away).mag() > 1);
+}
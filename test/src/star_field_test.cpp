@@ -0,0 +1,66 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "quad_tree.h"
+#include "star_field.h"
+
+namespace {
+
+using point = vec2d_t<double>;
+
+auto less(point const &a, point const &b) -> bool {
+    return a.x < b.x || (!(b.x < a.x) && a.y < b.y);
+}
+
+auto sorted(std::vector<point> v) -> std::vector<point> {
+    std::sort(v.begin(), v.end(), less);
+    return v;
+}
+
+auto same(std::vector<point> const &a, std::vector<point> const &b) -> bool {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](auto &p, auto &q) {
+               return !less(p, q) && !less(q, p);
+           });
+}
+
+} // namespace
+
+TEST_CASE("Stars only depend on the seed and where you look", "[stars]") {
+    constexpr uint64_t seed = 42;
+    rect<double>       view{{-1500, 2200}, {3000, 2500}};
+
+    star_field         field{seed};
+    std::vector<point> first;
+    field.items(first, view);
+    REQUIRE(!first.empty());
+    for(auto const &p : first) {
+        REQUIRE(shape_hit(view, p));
+    }
+
+    // far away, over more tiles than are kept, then back again
+    constexpr double   far_size = 20 * star_tile_size;
+    std::vector<point> elsewhere;
+    field.items(elsewhere, {{1e9, -1e9}, {far_size, far_size}});
+    CHECK(elsewhere.size() > star_tile_cache * stars_per_tile / 2);
+    std::vector<point> again;
+    field.items(again, view);
+    CHECK(same(sorted(first), sorted(again)));
+
+    // a fresh field, looking at the view in two halves
+    star_field         other{seed};
+    std::vector<point> left;
+    std::vector<point> right;
+    other.items(left, {view.position, {view.size.x / 2, view.size.y}});
+    other.items(right, {{view.position.x + view.size.x / 2, view.position.y},
+                        {view.size.x / 2, view.size.y}});
+    left.insert(left.end(), right.begin(), right.end());
+    CHECK(same(sorted(first), sorted(left)));
+
+    star_field         reseeded{seed + 1};
+    std::vector<point> different;
+    reseeded.items(different, view);
+    CHECK(!same(sorted(first), sorted(different)));
+}
@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <vector>
+
+#include "constants.h"
+#include "simulation.h"
+#include "stream.h"
+
+namespace {
+
+constexpr double frame_time = 1.0 / 60;
+
+// The payload of the one frame in bytes, after its size.
+auto payload_of(std::vector<uint8_t> const &bytes)
+    -> std::span<uint8_t const> {
+    size_t   pos  = 0;
+    uint64_t size = 0;
+    for(unsigned shift = 0;; shift += 7) {
+        auto b = bytes[pos++];
+        size   |= static_cast<uint64_t>(b & 0x7fU) << shift;
+        if((b & 0x80U) == 0) {
+            break;
+        }
+    }
+    REQUIRE(pos + size == bytes.size());
+    return std::span{bytes}.subspan(pos);
+}
+
+// Every boid where the decoder put it, in slot order like the decoder.
+void check_boids(state &st, frame_t const &f) {
+    auto handles = st.boids.entities.items();
+    std::sort(handles.begin(), handles.end(),
+              [](auto a, auto b) { return a.index < b.index; });
+    REQUIRE(f.boids_left == handles.size());
+    REQUIRE(f.boid_positions.size() == handles.size());
+    for(size_t i = 0; i < handles.size(); ++i) {
+        auto const &b = st.boids.entities[handles[i]];
+        REQUIRE((f.boid_positions[i] - b.p_rect.position).mag() <=
+                1 / stream_position_scale);
+        auto turn = std::remainder(
+            f.boid_velocities[i].theta() - b.velocity.theta(), 2 * M_PI);
+        REQUIRE(std::abs(turn) <= M_PI / 256 + 1e-9);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Decoded frames follow the simulation", "[stream]") {
+    state st{world_seed, window_rect};
+    st.frame_time = frame_time;
+
+    stream_encoder       encoder;
+    stream_decoder       decoder;
+    frame_t              f;
+    std::vector<uint8_t> bytes;
+    size_t               delta_bytes = 0;
+    size_t               delta_boids = 0;
+    for(size_t frame = 0; frame < 60; ++frame) {
+        update(st);
+        if(frame % 10 == 5) {
+            // boids gone and new ones in their slots
+            auto h = st.boids.entities.items().front();
+            explode(st, st.boids.entities[h].p_rect.position);
+            for(int i = 0; i < 3; ++i) {
+                auto b = random_boid(st.boid_rng,
+                                     number_of_boids + st.boids_spawned++);
+                st.boids.entities.insert(b, boid_key(b));
+            }
+        }
+        bytes.clear();
+        encoder.encode(st, bytes);
+        REQUIRE(decoder.decode(payload_of(bytes), f, true));
+        check_boids(st, f);
+        REQUIRE(f.shots.size() == st.shots.entities.size());
+        REQUIRE(f.explosions.size() == st.explosions.size());
+        if(frame > 0) {
+            delta_bytes += bytes.size();
+            delta_boids += st.boids.entities.size();
+        }
+    }
+    auto bytes_per_boid = static_cast<double>(delta_bytes) /
+                          static_cast<double>(delta_boids);
+    CHECK(bytes_per_boid < 4);
+
+    // a new reader starts from a whole frame
+    encoder.reset();
+    stream_decoder late;
+    bytes.clear();
+    encoder.encode(st, bytes);
+    REQUIRE(late.decode(payload_of(bytes), f, true));
+    check_boids(st, f);
+
+    auto cut = payload_of(bytes);
+    CHECK(!stream_decoder{}.decode(cut.first(cut.size() / 2), f, true));
+}
+
+TEST_CASE("Stream headers name the version", "[stream]") {
+    auto          bytes = encode_header({stream_magic, stream_version, 42});
+    stream_header h;
+    REQUIRE(bytes.size() == stream_header_size);
+    REQUIRE(decode_header(bytes, h));
+    CHECK(h.seed == 42);
+
+    bytes[4] = static_cast<uint8_t>(stream_version + 1);
+    CHECK(!decode_header(bytes, h));
+}
@@ -0,0 +1,93 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "alloc_tracker.h"
+#include "task_graph.h"
+
+TEST_CASE("Tasks run once each, after what they depend on", "[task_graph]") {
+    constexpr int threads = 4;
+    constexpr int rounds  = 1000;
+
+    // a diamond with a tail: a before b and c, both before d, d before e
+    task_graph        g{threads};
+    std::atomic<int>  step{0};
+    std::vector<int>  at(5);
+    std::atomic<bool> ordered{true};
+
+    auto mark = [&](size_t task, std::initializer_list<size_t> after) {
+        for(size_t a : after) {
+            if(at[a] == 0) {
+                ordered = false;
+            }
+        }
+        at[task] = ++step;
+    };
+    auto a = g.add([&] { mark(0, {}); });
+    auto b = g.add([&] { mark(1, {0}); }, {a});
+    auto c = g.add([&] { mark(2, {0}); }, {a});
+    auto d = g.add([&] { mark(3, {1, 2}); }, {b, c});
+    g.add([&] { mark(4, {3}); }, {d});
+
+    for(int r = 0; r < rounds; ++r) {
+        step = 0;
+        std::fill(at.begin(), at.end(), 0);
+        g.run();
+        REQUIRE(step == 5);
+        REQUIRE(ordered);
+        REQUIRE(at[0] < at[1]);
+        REQUIRE(at[0] < at[2]);
+        REQUIRE(at[3] > std::max(at[1], at[2]));
+        REQUIRE(at[4] > at[3]);
+    }
+}
+
+TEST_CASE("Independent tasks overlap", "[task_graph]") {
+    // each waits for the other to start, so they can only finish together
+    task_graph        g{2};
+    std::atomic<int>  started{0};
+    std::atomic<bool> both{false};
+    auto              meet = [&] {
+        ++started;
+        while(started < 2) {
+        }
+        both = true;
+    };
+    g.add(meet);
+    g.add(meet);
+    g.run();
+    CHECK(both);
+}
+
+TEST_CASE("Allocations in tasks count as the caller's", "[task_graph]") {
+    if(!allocations_tracked()) {
+        WARN("needs FLOX_TRACK_ALLOCATIONS");
+        return;
+    }
+    // meeting as above puts at least one of them on a worker thread
+    task_graph                    g{2};
+    std::atomic<int>              started{0};
+    std::vector<std::vector<int>> kept(2);
+    auto                          allocate = [&](size_t i) {
+        ++started;
+        while(started < 2) {
+        }
+        kept[i].resize(64);
+    };
+    g.add([&] { allocate(0); });
+    g.add([&] { allocate(1); });
+    g.run(); // starts the workers, which allocates
+    started = 0;
+    kept    = std::vector<std::vector<int>>(2);
+
+    auto before = thread_allocations();
+    auto errors = thread_alloc_violations();
+    {
+        no_alloc_scope scope{"task graph test"};
+        g.run();
+    }
+    CHECK((thread_allocations() - before).count == 2);
+    CHECK(thread_alloc_violations() - errors == 2);
+}